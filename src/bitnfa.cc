@@ -0,0 +1,302 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Bit-parallel NFA simulation (write exec_bitset). Instead of following one
+ * NFA alternative at a time and backtracking, the machine is run breadth-first
+ * over the set of all states it could be in, held as a bit set. Each character
+ * costs at most one table lookup per active state, so the time is linear in
+ * the input no matter how ambiguous the machine is.
+ *
+ * The tables hold, for each character class and state, the set of states
+ * reachable by that character, closed over the NFA transitions. Characters
+ * that no state distinguishes share a class.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+/* Largest machine the simulation is generated for, in states. */
+#define BITSET_MAX_STATES 512
+
+/* Largest alphabet the class map is generated for. */
+#define BITSET_MAX_SPAN 0x10000
+
+typedef std::vector<unsigned long long> BitSet;
+
+static void bitsetClose( BitSet &set, std::map<StateAp*, long> &index, StateAp *state )
+{
+	long i = index[state];
+	if ( set[i / 64] & ( 1ULL << ( i % 64 ) ) )
+		return;
+
+	set[i / 64] |= 1ULL << ( i % 64 );
+	if ( state->nfaOut != 0 ) {
+		for ( NfaTransList::Iter nt = *state->nfaOut; nt.lte(); nt++ )
+			bitsetClose( set, index, nt->toState );
+	}
+}
+
+bool ParseData::bitsetCheck( const InputLoc &loc )
+{
+	if ( fsmCtx->getKeyExpr != 0 ) {
+		id->error( loc ) << "write exec_bitset cannot be used with getkey" << endl;
+		return false;
+	}
+
+	if ( lmList.length() > 0 ) {
+		id->error( loc ) << "write exec_bitset cannot be used with scanners" << endl;
+		return false;
+	}
+
+	if ( sectionGraph->stateList.length() > BITSET_MAX_STATES ) {
+		id->error( loc ) << "write exec_bitset: machine has more than " <<
+				BITSET_MAX_STATES << " states" << endl;
+		return false;
+	}
+
+	KeyOps *keyOps = fsmCtx->keyOps;
+	if ( keyOps->span( keyOps->minKey, keyOps->maxKey ) > BITSET_MAX_SPAN ) {
+		id->error( loc ) << "write exec_bitset: alphabet type is too wide" << endl;
+		return false;
+	}
+
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		bool actions = st->toStateActionTable.length() > 0 ||
+				st->fromStateActionTable.length() > 0 ||
+				st->eofActionTable.length() > 0;
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( !trans->plain() ) {
+				id->error( loc ) << "write exec_bitset cannot be used "
+						"with conditions" << endl;
+				return false;
+			}
+			if ( trans->tdap()->actionTable.length() > 0 )
+				actions = true;
+		}
+
+		if ( st->nfaOut != 0 ) {
+			for ( NfaTransList::Iter nt = *st->nfaOut; nt.lte(); nt++ ) {
+				if ( nt->popCondSpace != 0 || nt->popTest.length() > 0 ) {
+					id->error( loc ) << "write exec_bitset cannot be used "
+							"with NFA repetition" << endl;
+					return false;
+				}
+				if ( nt->pushTable.length() > 0 || nt->popAction.length() > 0 )
+					actions = true;
+			}
+		}
+
+		if ( actions ) {
+			id->error( loc ) << "write exec_bitset requires a machine "
+					"without actions" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void writeBitSet( std::ostream &out, const BitSet &set )
+{
+	out << "{ ";
+	for ( size_t w = 0; w < set.size(); w++ )
+		out << "0x" << std::hex << set[w] << std::dec << "ULL, ";
+	out << "}";
+}
+
+void ParseData::writeExecBitset( std::ostream &out, const InputLoc &loc )
+{
+	if ( !bitsetCheck( loc ) )
+		return;
+
+	KeyOps *keyOps = fsmCtx->keyOps;
+	long numStates = sectionGraph->stateList.length();
+	long words = numStates > 0 ? ( numStates + 63 ) / 64 : 1;
+	unsigned long long alphSpan = keyOps->span( keyOps->minKey, keyOps->maxKey );
+
+	std::map<StateAp*, long> index;
+	long i = 0;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++, i++ )
+		index[st] = i;
+
+	/* Class boundaries are wherever any state's target may change. */
+	std::vector<bool> boundary( alphSpan + 1, false );
+	boundary[0] = true;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			unsigned long long low = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+			boundary[low] = true;
+			boundary[low + keyOps->span( trans->lowKey, trans->highKey )] = true;
+		}
+	}
+
+	/* Columns: per class, the follow set of every state. Identical columns
+	 * share a class. */
+	std::vector<long> keyClass( alphSpan );
+	std::vector< std::vector<BitSet> > columns;
+	std::map<std::string, long> columnIds;
+
+	std::vector<BitSet> column;
+	std::string signature;
+	for ( unsigned long long k = 0; k < alphSpan; k++ ) {
+		if ( boundary[k] ) {
+			column.clear();
+			std::stringstream sig;
+			for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+				BitSet follow( words, 0 );
+				for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+					unsigned long long low = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+					unsigned long long high = low + keyOps->span( trans->lowKey, trans->highKey );
+					if ( low <= k && k < high && trans->tdap()->toState != 0 ) {
+						bitsetClose( follow, index, trans->tdap()->toState );
+						break;
+					}
+				}
+				for ( long w = 0; w < words; w++ )
+					sig << follow[w] << ",";
+				column.push_back( follow );
+			}
+			signature = sig.str();
+
+			if ( columnIds.find( signature ) == columnIds.end() ) {
+				columnIds[signature] = columns.size();
+				columns.push_back( column );
+			}
+		}
+		keyClass[k] = columnIds[signature];
+	}
+
+	BitSet start( words, 0 ), final( words, 0 );
+	if ( sectionGraph->startState != 0 )
+		bitsetClose( start, index, sectionGraph->startState );
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		if ( st->isFinState() )
+			final[index[st] / 64] |= 1ULL << ( index[st] % 64 );
+	}
+
+	long classBytes = columns.size() <= 0x100 ? 1 : 2;
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-bitset-states\t" << numStates << endl;
+		id->stats() << "fsm-bitset-classes\t" << columns.size() << endl;
+		id->stats() << "fsm-bitset-bytes\t" << ( alphSpan * classBytes +
+				columns.size() * numStates * words * 8 ) << endl;
+	}
+
+	std::string name = sectionName;
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+
+	out <<
+		"struct " << name << "_bitset\n"
+		"{\n"
+		"	unsigned long long s[" << words << "];\n"
+		"};\n"
+		"\n"
+		"static const unsigned " << ( classBytes == 1 ? "char" : "short" ) <<
+				" " << name << "_bitset_class[] = {\n\t";
+	for ( unsigned long long k = 0; k < alphSpan; k++ ) {
+		out << keyClass[k] << ", ";
+		if ( k % 16 == 15 )
+			out << "\n\t";
+	}
+	out << "\n};\n"
+		"\n"
+		"static const unsigned long long " << name << "_bitset_follow[][" <<
+				numStates << "][" << words << "] = {\n";
+	for ( size_t c = 0; c < columns.size(); c++ ) {
+		out << "\t{ ";
+		for ( size_t s = 0; s < columns[c].size(); s++ ) {
+			writeBitSet( out, columns[c][s] );
+			out << ", ";
+		}
+		out << "},\n";
+	}
+	out << "};\n"
+		"\n"
+		"static const unsigned long long " << name << "_bitset_start[] = ";
+	writeBitSet( out, start );
+	out << ";\n"
+		"static const unsigned long long " << name << "_bitset_final[] = ";
+	writeBitSet( out, final );
+	out << ";\n"
+		"\n"
+		"static void " << name << "_bitset_init( struct " << name << "_bitset *b )\n"
+		"{\n"
+		"	int w;\n"
+		"	for ( w = 0; w < " << words << "; w++ )\n"
+		"		b->s[w] = " << name << "_bitset_start[w];\n"
+		"}\n"
+		"\n"
+		"/* Returns zero once no state is left, the equivalent of the error state. */\n"
+		"static int " << name << "_bitset_exec( struct " << name << "_bitset *b, " <<
+				alph << " *p, " << alph << " *pe )\n"
+		"{\n"
+		"	unsigned long long next[" << words << "], m, any;\n"
+		"	const unsigned long long (*follow)[" << words << "];\n"
+		"	int w, s, x;\n"
+		"\n"
+		"	for ( ; p < pe; p++ ) {\n"
+		"		follow = " << name << "_bitset_follow[" << name << "_bitset_class[(long)*p - (" <<
+				keyOps->minKey.getVal() << "L)]];\n"
+		"		for ( w = 0; w < " << words << "; w++ )\n"
+		"			next[w] = 0;\n"
+		"		for ( w = 0; w < " << words << "; w++ ) {\n"
+		"			for ( m = b->s[w], s = w * 64; m != 0; m >>= 1, s++ ) {\n"
+		"				if ( m & 1 ) {\n"
+		"					for ( x = 0; x < " << words << "; x++ )\n"
+		"						next[x] |= follow[s][x];\n"
+		"				}\n"
+		"			}\n"
+		"		}\n"
+		"		any = 0;\n"
+		"		for ( w = 0; w < " << words << "; w++ ) {\n"
+		"			b->s[w] = next[w];\n"
+		"			any |= next[w];\n"
+		"		}\n"
+		"		if ( any == 0 )\n"
+		"			return 0;\n"
+		"	}\n"
+		"	return 1;\n"
+		"}\n"
+		"\n"
+		"static int " << name << "_bitset_accept( const struct " << name << "_bitset *b )\n"
+		"{\n"
+		"	int w;\n"
+		"	for ( w = 0; w < " << words << "; w++ ) {\n"
+		"		if ( b->s[w] & " << name << "_bitset_final[w] )\n"
+		"			return 1;\n"
+		"	}\n"
+		"	return 0;\n"
+		"}\n";
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Table blob (--table-blob). The arrays written by write data are stored in a
+ * binary file next to the output, foo.rlt for foo.c, which the output includes
+ * by file name with the assembler's .incbin. Each array name becomes a macro
+ * for a pointer into it, so the exec code is unchanged and the host compiler
+ * does not parse the initializers. The file starts with an eight byte header:
+ * "RLT", the format version, the sizes of long, int and short, then 'L' or
+ * 'B' for the byte order. The values are in the byte order of the machine
+ * running ragel, and the output checks the header against the target with
+ * static assertions.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfsm/ragel.h>
+#include "inputdata.h"
+
+using std::endl;
+
+#define BLOB_VERSION 2
+
+/* Size of an element of the given C type, or zero if it is not known. */
+static int blobTypeSize( const std::string &type )
+{
+	if ( type == "char" || type == "signed char" || type == "unsigned char" )
+		return 1;
+	if ( type == "short" || type == "unsigned short" )
+		return sizeof(short);
+	if ( type == "int" || type == "unsigned int" || type == "unsigned" )
+		return sizeof(int);
+	if ( type == "long" || type == "unsigned long" )
+		return sizeof(long);
+	if ( type == "long long" || type == "unsigned long long" )
+		return sizeof(long long);
+	return 0;
+}
+
+/* Parse the initializer. Returns false if anything in it is not a number. */
+static bool blobValues( const std::string &def, std::vector<long long> &values )
+{
+	std::string::size_type open = def.find( '{' ), close = def.rfind( '}' );
+	if ( open == std::string::npos || close == std::string::npos || close < open )
+		return false;
+
+	std::string list = def.substr( open + 1, close - open - 1 );
+	for ( std::string::size_type i = 0; i < list.size(); i++ ) {
+		if ( list[i] == ',' || list[i] == '\n' || list[i] == '\t' )
+			list[i] = ' ';
+	}
+
+	std::istringstream in( list );
+	std::string tok;
+	while ( in >> tok ) {
+		char *end = 0;
+		long long v = strtoll( tok.c_str(), &end, 0 );
+		while ( *end == 'u' || *end == 'U' || *end == 'l' || *end == 'L' )
+			end++;
+		if ( end == tok.c_str() || *end != 0 )
+			return false;
+		values.push_back( v );
+	}
+	return true;
+}
+
+static void blobWrite( std::ostream &out, long long v, int size )
+{
+	unsigned char c = v;
+	unsigned short s = v;
+	unsigned int i = v;
+	unsigned long l = v;
+	unsigned long long ll = v;
+
+	if ( size == 1 )
+		out.write( (char*)&c, 1 );
+	else if ( size == sizeof(short) )
+		out.write( (char*)&s, size );
+	else if ( size == sizeof(int) )
+		out.write( (char*)&i, size );
+	else if ( size == sizeof(long) )
+		out.write( (char*)&l, size );
+	else
+		out.write( (char*)&ll, size );
+}
+
+void InputData::blobTables( const std::string &data )
+{
+	if ( blobStream == 0 ) {
+		if ( outputFileName == 0 )
+			error() << "--table-blob requires an output file" << endp;
+
+		std::string fn = outputFileWith( ".rlt" );
+
+		std::ofstream *blob = new std::ofstream( fn.c_str(),
+				std::ios::out | std::ios::trunc | std::ios::binary );
+		if ( !blob->is_open() )
+			error() << "error opening " << fn << " for writing" << endp;
+
+		unsigned short one = 1;
+		char order = *(unsigned char*)&one == 1 ? 'L' : 'B';
+
+		char header[8] = { 'R', 'L', 'T', BLOB_VERSION, (char)sizeof(long),
+				(char)sizeof(int), (char)sizeof(short), order };
+		blob->write( header, sizeof(header) );
+		blobStream = blob;
+		blobBytes = sizeof(header);
+
+		/* A symbol for the blob unique to the output file. */
+		blobSymbol = "_rlt_" + outputSymbol();
+
+		/* The assembler resolves .incbin against its working directory and
+		 * -I paths, so give the name without the directory. Compiling
+		 * elsewhere needs -Wa,-I<dir>. */
+		std::string::size_type slash = fn.rfind( '/' );
+		std::string incbin = slash == std::string::npos ?
+				fn : fn.substr( slash + 1 );
+
+		std::stringstream sizes, byteOrder;
+		sizes << "sizeof(long) == " << sizeof(long) << " && sizeof(int) == " <<
+				sizeof(int) << " && sizeof(short) == " << sizeof(short);
+		byteOrder << "__BYTE_ORDER__ == " << ( order == 'L' ?
+				"__ORDER_LITTLE_ENDIAN__" : "__ORDER_BIG_ENDIAN__" );
+
+		*outStream <<
+			"__asm__(\n"
+			"	\".section .rodata\\n\"\n"
+			"	\".balign 16\\n\"\n"
+			"	\".global " << blobSymbol << "\\n\"\n"
+			"	\".hidden " << blobSymbol << "\\n\"\n"
+			"	\"" << blobSymbol << ":\\n\"\n"
+			"	\".incbin \\\"" << incbin << "\\\"\\n\"\n"
+			"	\".previous\\n\"\n"
+			");\n"
+			"extern const unsigned char " << blobSymbol << "[];\n";
+
+		/* Fail the build of a target the blob was not written for. */
+		for ( int c = 0; c < 2; c++ ) {
+			const char *check = c == 0 ? "static_assert" : "_Static_assert";
+			*outStream << ( c == 0 ? "#ifdef __cplusplus\n" : "#else\n" ) <<
+				check << "( " << sizes.str() << ",\n"
+				"	\"" << incbin << ": type sizes differ\" );\n" <<
+				check << "( " << byteOrder.str() << ",\n"
+				"	\"" << incbin << ": byte order differs\" );\n";
+		}
+		*outStream << "#endif\n\n";
+	}
+
+	std::istringstream in( data );
+	std::string line;
+	while ( std::getline( in, line ) ) {
+		TableArray array;
+		if ( !readTableArray( in, line, array ) ) {
+			*outStream << line << '\n';
+			continue;
+		}
+
+		int size = blobTypeSize( array.type );
+		std::vector<long long> values;
+		if ( size == 0 || !blobValues( array.init, values ) ) {
+			*outStream << "static const " << array.type << " " <<
+					array.name << "[] " << array.init;
+			continue;
+		}
+
+		/* Align every array to its element size. */
+		while ( blobBytes % size != 0 ) {
+			blobStream->put( 0 );
+			blobBytes += 1;
+		}
+
+		*outStream << "#define " << array.name << " ((const " << array.type << " *)( " <<
+				blobSymbol << " + " << blobBytes << " ))\n";
+
+		for ( size_t v = 0; v < values.size(); v++ )
+			blobWrite( *blobStream, values[v], size );
+		blobBytes += values.size() * size;
+	}
+}
+
+void InputData::closeBlob()
+{
+	if ( blobStream == 0 )
+		return;
+
+	if ( printStatistics )
+		stats() << "table-blob-bytes\t" << blobBytes << endl;
+
+	delete blobStream;
+	blobStream = 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Input buffer for pull scanners (write buffer). The generated functions do
+ * what every scanner reading from a file descriptor otherwise writes by hand:
+ * keep the partial token from ts to pe, move it to the front of the buffer,
+ * fix up the pointers and read more after it. When the kept part fills the
+ * buffer it is grown, up to an optional limit. A regular file can instead be
+ * mapped whole, in which case there is nothing to refill and tokens are never
+ * copied.
+ */
+
+#include <iostream>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+void ParseData::writeBuffer( std::ostream &out, const InputLoc &loc )
+{
+	if ( fsmCtx->getKeyExpr != 0 ) {
+		id->error( loc ) << "write buffer cannot be used with getkey" << endl;
+		return;
+	}
+
+	std::string name = sectionName;
+	std::string alph = alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+	std::string ptr = alph + " *";
+
+	out <<
+		"struct " << name << "_buf\n"
+		"{\n"
+		"	" << ptr << "data;\n"
+		"	size_t size;\n"
+		"	size_t max;\n"
+		"	size_t maplen;\n"
+		"	int fd;\n"
+		"	int mapped;\n"
+		"};\n"
+		"\n"
+		"/* Read from fd into a buffer of size elements that may grow to max, or\n"
+		" * without limit if max is zero. Sets p and pe to the empty buffer. */\n"
+		"static int " << name << "_buf_open( struct " << name << "_buf *b, int fd,\n"
+		"		size_t size, size_t max, " << ptr << "*p, " << ptr << "*pe )\n"
+		"{\n"
+		"	b->data = (" << ptr << ") malloc( size * sizeof(" << alph << ") );\n"
+		"	if ( b->data == 0 )\n"
+		"		return -1;\n"
+		"	b->size = size;\n"
+		"	b->max = max;\n"
+		"	b->maplen = 0;\n"
+		"	b->fd = fd;\n"
+		"	b->mapped = 0;\n"
+		"	*p = *pe = b->data;\n"
+		"	return 0;\n"
+		"}\n"
+		"\n"
+		"/* Map all of the regular file fd. Sets p and pe to the whole of it. */\n"
+		"static int " << name << "_buf_map( struct " << name << "_buf *b, int fd,\n"
+		"		" << ptr << "*p, " << ptr << "*pe )\n"
+		"{\n"
+		"	struct stat st;\n"
+		"	if ( fstat( fd, &st ) != 0 )\n"
+		"		return -1;\n"
+		"	b->size = st.st_size / sizeof(" << alph << ");\n"
+		"	b->max = b->size;\n"
+		"	b->maplen = st.st_size;\n"
+		"	b->fd = -1;\n"
+		"	b->mapped = 1;\n"
+		"	b->data = 0;\n"
+		"	if ( st.st_size > 0 ) {\n"
+		"		void *m = mmap( 0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );\n"
+		"		if ( m == MAP_FAILED )\n"
+		"			return -1;\n"
+		"		b->data = (" << ptr << ") m;\n"
+		"	}\n"
+		"	*p = b->data;\n"
+		"	*pe = b->data + b->size;\n"
+		"	return 0;\n"
+		"}\n"
+		"\n"
+		"static void " << name << "_buf_close( struct " << name << "_buf *b )\n"
+		"{\n"
+		"	if ( b->mapped ) {\n"
+		"		if ( b->data != 0 )\n"
+		"			munmap( b->data, b->maplen );\n"
+		"	}\n"
+		"	else {\n"
+		"		free( b->data );\n"
+		"	}\n"
+		"	b->data = 0;\n"
+		"}\n"
+		"\n"
+		"/* Call when p reaches pe. Keeps the input from ts (if not null) to pe and\n"
+		" * reads more after it. Pointers into the kept input are moved with it; ts\n"
+		" * and te may be null if the machine is not a scanner. te is cleared if it\n"
+		" * is before the kept input, as a finished token leaves it. Returns the\n"
+		" * number of elements read. At the end of input returns 0 and sets eof to\n"
+		" * pe. Returns -1 on a read or allocation error, or if the input ends\n"
+		" * inside an element, and -2 if a token does not fit in the largest buffer\n"
+		" * allowed. */\n"
+		"static long " << name << "_buf_fill( struct " << name << "_buf *b,\n"
+		"		" << ptr << "*p, " << ptr << "*pe, " << ptr << "*eof,\n"
+		"		" << ptr << "*ts, " << ptr << "*te )\n"
+		"{\n"
+		"	" << ptr << "keep = ( ts != 0 && *ts != 0 ) ? *ts : *p;\n"
+		"	size_t shift = keep - b->data, have = *pe - keep;\n"
+		"	size_t op = *p - keep;\n"
+		"	long ots = 0, ote = -1, len;\n"
+		"	size_t room, got = 0;\n"
+		"\n"
+		"	if ( b->mapped ) {\n"
+		"		*eof = *pe;\n"
+		"		return 0;\n"
+		"	}\n"
+		"\n"
+		"	if ( ts != 0 && *ts != 0 )\n"
+		"		ots = *ts - keep;\n"
+		"	if ( te != 0 && *te != 0 && *te >= keep )\n"
+		"		ote = *te - keep;\n"
+		"\n"
+		"	if ( shift > 0 && have > 0 )\n"
+		"		memmove( b->data, keep, have * sizeof(" << alph << ") );\n"
+		"\n"
+		"	if ( have == b->size ) {\n"
+		"		size_t size = b->size * 2;\n"
+		"		" << ptr << "data;\n"
+		"		if ( b->max != 0 && size > b->max )\n"
+		"			size = b->max;\n"
+		"		if ( size <= b->size )\n"
+		"			return -2;\n"
+		"		data = (" << ptr << ") realloc( b->data, size * sizeof(" << alph << ") );\n"
+		"		if ( data == 0 )\n"
+		"			return -1;\n"
+		"		b->data = data;\n"
+		"		b->size = size;\n"
+		"	}\n"
+		"\n"
+		"	*p = b->data + op;\n"
+		"	*pe = b->data + have;\n"
+		"	if ( ts != 0 && *ts != 0 )\n"
+		"		*ts = b->data + ots;\n"
+		"	if ( te != 0 )\n"
+		"		*te = ote >= 0 ? b->data + ote : 0;\n"
+		"\n"
+		"	/* A read may stop inside an element. Its bytes are already taken from\n"
+		"	 * fd, so read the rest of it before returning. */\n"
+		"	room = ( b->size - have ) * sizeof(" << alph << ");\n"
+		"	do {\n"
+		"		len = read( b->fd, (char*)*pe + got, room - got );\n"
+		"		if ( len < 0 )\n"
+		"			return -1;\n"
+		"		got += len;\n"
+		"	} while ( len > 0 && got % sizeof(" << alph << ") != 0 );\n"
+		"	if ( got % sizeof(" << alph << ") != 0 )\n"
+		"		return -1;\n"
+		"\n"
+		"	len = got / sizeof(" << alph << ");\n"
+		"	*pe += len;\n"
+		"	if ( len == 0 )\n"
+		"		*eof = *pe;\n"
+		"	return len;\n"
+		"}\n"
+		"\n";
+}
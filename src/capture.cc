@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Captures. :capture( n, expr ): stores the position of the first character
+ * of expr in cap[2n] and the position following its last in cap[2n+1]. It is
+ * shorthand for an entering and a leaving action written by hand. The actions
+ * are made once per register and shared by every capture that uses it, and
+ * each is a single store, but they are ordinary actions and run through the
+ * generated action code like any other. Stores kept in the transition tables
+ * would need support in the code generators.
+ */
+
+#include <iostream>
+#include <sstream>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+FsmRes Factor::walkCapture( ParseData *pd )
+{
+	FsmRes exprTree = expression->walk( pd );
+	if ( !exprTree.success() )
+		return exprTree;
+
+	if ( exprTree.fsm->startState->isFinState() ) {
+		pd->id->warning( loc ) << "capture of a machine that accepts the zero "
+				"length word is not stored when the word is empty" << endl;
+	}
+
+	exprTree.fsm->startFsmAction( pd->fsmCtx->curActionOrd++,
+			pd->captureAction( loc, repId * 2 ) );
+	exprTree.fsm->leaveFsmAction( pd->fsmCtx->curActionOrd++,
+			pd->captureAction( loc, repId * 2 + 1 ) );
+	return exprTree;
+}
+
+Action *ParseData::captureAction( const InputLoc &loc, long reg )
+{
+	std::map<long, Action*>::iterator c = captureActions.find( reg );
+	if ( c != captureActions.end() )
+		return c->second;
+
+	std::stringstream head;
+	head << "{ cap[" << reg << "] = ";
+
+	InlineList *il = new InlineList;
+	il->append( new InlineItem( loc, head.str(), InlineItem::Text ) );
+	il->append( new InlineItem( loc, InlineItem::PChar ) );
+	il->append( new InlineItem( loc, "; }", InlineItem::Text ) );
+
+	std::stringstream name;
+	name << "cap" << reg;
+
+	Action *action = new Action( loc, name.str(), il, fsmCtx->nextCondId++ );
+	action->embedRoots.append( rootName );
+	fsmCtx->actionList.append( action );
+
+	captureActions[reg] = action;
+	return action;
+}
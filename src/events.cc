@@ -0,0 +1,295 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Event log exec. With "write exec events;" the user actions of a machine are
+ * not run from the exec loop. Each action instead appends an (id, p) record
+ * to the caller's event buffer:
+ *
+ *     struct <name>_event *ev;   the buffer
+ *     int ev_len;                number of events in the buffer
+ *     int ev_cap;                capacity of the buffer
+ *
+ * When fewer than <name>_event_reserve free slots remain the machine breaks
+ * out after the current character. The caller drains the buffer (for example
+ * with "write events;", which runs the original action bodies over the
+ * recorded events, in order) and calls exec again. Since the action bodies
+ * run after the fact, they may not change the machine's control flow.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <map>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+InputItem *ParseData::findWriteOption( const char *cmd, const char *opt )
+{
+	for ( InputItemList::Iter ii = id->inputItems; ii.lte(); ii++ ) {
+		if ( ii->type == InputItem::Write && ii->pd == this &&
+				ii->writeArgs.size() > 0 && ii->writeArgs[0] == cmd )
+		{
+			for ( size_t i = 1; i < ii->writeArgs.size(); i++ ) {
+				if ( ii->writeArgs[i] == opt )
+					return ii;
+			}
+		}
+	}
+	return 0;
+}
+
+/* Check that the deferred action body can be run outside of the machine. */
+static bool eventSafe( ParseData *pd, Action *action, InlineList *inlineList )
+{
+	bool safe = true;
+	for ( InlineList::Iter item = *inlineList; item.lte(); item++ ) {
+		switch ( item->type ) {
+			case InlineItem::Text:
+			case InlineItem::PChar:
+			case InlineItem::Char:
+				break;
+			default:
+				pd->id->error( item->loc ) << "action \"" << action->name <<
+						"\": event log actions cannot contain statements "
+						"that affect the machine (fhold, fexec, fgoto, "
+						"fcall, fret, fbreak, fcurs, ...)" << endl;
+				safe = false;
+				break;
+		}
+
+		if ( item->children != 0 && !eventSafe( pd, action, item->children ) )
+			safe = false;
+	}
+	return safe;
+}
+
+static void countTable( std::set<Action*> &used, ActionTable &table, long &max )
+{
+	for ( ActionTable::Iter ati = table; ati.lte(); ati++ )
+		used.insert( ati->value );
+	if ( table.length() > max )
+		max = table.length();
+}
+
+static void condActions( std::set<Action*> &conds, CondSpace *condSpace )
+{
+	if ( condSpace != 0 ) {
+		for ( CondSet::Iter csi = condSpace->condSet; csi.lte(); csi++ )
+			conds.insert( *csi );
+	}
+}
+
+/* Replace the body of an action with an append to the event buffer. */
+InlineList *ParseData::eventAppend( const InputLoc &loc, long eventId, bool canBreak )
+{
+	std::stringstream head;
+	head << "{ ev[ev_len].id = " << eventId << "; ev[ev_len].p = ";
+
+	InlineList *il = new InlineList;
+	il->append( new InlineItem( loc, head.str(), InlineItem::Text ) );
+	il->append( new InlineItem( loc, InlineItem::PChar ) );
+
+	if ( canBreak ) {
+		std::stringstream check;
+		check << "; ev_len += 1; if ( ev_len > ev_cap - " << eventReserve << " ) ";
+		il->append( new InlineItem( loc, check.str(), InlineItem::Text ) );
+		il->append( new InlineItem( loc, InlineItem::Nbreak ) );
+		il->append( new InlineItem( loc, " }", InlineItem::Text ) );
+	}
+	else {
+		il->append( new InlineItem( loc, "; ev_len += 1; }", InlineItem::Text ) );
+	}
+	return il;
+}
+
+/* Called after the graph is built, before analysis and reduction. */
+void ParseData::makeEventLog( FsmAp *graph, const HostLang *hostLang )
+{
+	const InputLoc &loc = eventsWrite->loc;
+
+	if ( hostLang != &hostLangC ) {
+		id->error( loc ) << "write exec events is only supported "
+				"by the C host language" << endl;
+		return;
+	}
+
+	if ( lmList.length() > 0 ) {
+		id->error( loc ) << "write exec events cannot be used "
+				"with scanners" << endl;
+		return;
+	}
+
+	std::set<Action*> used, conds;
+	long maxTrans = 0, maxTo = 0, maxFrom = 0, maxEof = 0;
+	std::set<Action*> eofUsed;
+
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		if ( st->nfaOut != 0 ) {
+			id->error( loc ) << "write exec events cannot be used "
+					"with NFA constructions" << endl;
+			return;
+		}
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( trans->plain() )
+				countTable( used, trans->tdap()->actionTable, maxTrans );
+			else {
+				condActions( conds, trans->tcap()->condSpace );
+				for ( CondList::Iter cond = trans->tcap()->condList; cond.lte(); cond++ )
+					countTable( used, cond->actionTable, maxTrans );
+			}
+		}
+
+		countTable( used, st->toStateActionTable, maxTo );
+		countTable( used, st->fromStateActionTable, maxFrom );
+		countTable( eofUsed, st->eofActionTable, maxEof );
+		condActions( conds, st->outCondSpace );
+	}
+
+	/* A single character can produce from-state, transition and to-state
+	 * events. Eof events come from a separate call, which also needs room. */
+	eventReserve = maxFrom + maxTrans + maxTo;
+	if ( maxEof > eventReserve )
+		eventReserve = maxEof;
+	if ( eventReserve == 0 )
+		eventReserve = 1;
+
+	/* Give every action that is run an id, in definition order. */
+	bool safe = true;
+	for ( ActionList::Iter act = fsmCtx->actionList; act.lte(); act++ ) {
+		if ( used.find( act ) == used.end() && eofUsed.find( act ) == eofUsed.end() )
+			continue;
+
+		if ( conds.find( act ) != conds.end() ) {
+			id->error( act->loc ) << "action \"" << act->name <<
+					"\": event log actions cannot also be used as conditions" << endl;
+			safe = false;
+			continue;
+		}
+
+		if ( !eventSafe( this, act, act->inlineList ) ) {
+			safe = false;
+			continue;
+		}
+
+		eventActions.push_back( EventAction( act, act->inlineList ) );
+	}
+
+	if ( !safe )
+		return;
+
+	/* Eof actions run outside the loop and must not break out, so they get
+	 * their own copy of the action. */
+	std::map<Action*, Action*> eofCopies;
+	for ( size_t e = 0; e < eventActions.size(); e++ ) {
+		Action *action = eventActions[e].action;
+
+		if ( eofUsed.find( action ) != eofUsed.end() ) {
+			Action *eofAction = new Action( action->loc, action->name,
+					eventAppend( action->loc, e, false ), fsmCtx->nextCondId++ );
+			eofAction->embedRoots.append( rootName );
+			fsmCtx->actionList.append( eofAction );
+			eofCopies[action] = eofAction;
+		}
+
+		action->inlineList = eventAppend( action->loc, e, true );
+	}
+
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		for ( ActionTable::Iter ati = st->eofActionTable; ati.lte(); ati++ )
+			ati->value = eofCopies[ati->value];
+	}
+}
+
+/* Identifiers usable in the event processing code. Emitted with the data. */
+void ParseData::writeEventData( std::ostream &out )
+{
+	out <<
+		"struct " << sectionName << "_event\n"
+		"{\n"
+		"	int id;\n"
+		"	const " << alphType->data1;
+	if ( alphType->data2 != 0 )
+		out << " " << alphType->data2;
+	out << " *p;\n"
+		"};\n"
+		"\n"
+		"static const int " << sectionName << "_event_reserve = " << eventReserve << ";\n";
+
+	for ( size_t e = 0; e < eventActions.size(); e++ ) {
+		const std::string &name = eventActions[e].action->name;
+		if ( !name.empty() && name.find_first_not_of(
+				"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_" ) ==
+				std::string::npos )
+		{
+			out << "static const int " << sectionName << "_ev_" << name <<
+					" = " << e << ";\n";
+		}
+	}
+	out << "\n";
+}
+
+static void writeEventBody( std::ostream &out, InlineList *inlineList )
+{
+	for ( InlineList::Iter item = *inlineList; item.lte(); item++ ) {
+		switch ( item->type ) {
+			case InlineItem::Text:
+				out << item->data;
+				break;
+			case InlineItem::PChar:
+				out << "(ev[_ev].p)";
+				break;
+			case InlineItem::Char:
+				out << "(*ev[_ev].p)";
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+/* Run the original action bodies over the recorded events. The body sees fpc
+ * and fc as they were when the event was recorded. */
+void ParseData::writeEventProcess( std::ostream &out )
+{
+	out <<
+		"{\n"
+		"	int _ev;\n"
+		"	for ( _ev = 0; _ev < ev_len; _ev++ ) {\n"
+		"		switch ( ev[_ev].id ) {\n";
+
+	for ( size_t e = 0; e < eventActions.size(); e++ ) {
+		out << "		case " << e << ": ";
+		writeEventBody( out, eventActions[e].body );
+		out << " break;\n";
+	}
+
+	out <<
+		"		}\n"
+		"	}\n"
+		"}\n";
+}
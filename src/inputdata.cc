@@ -220,9 +220,11 @@ void InputData::verifyWritesHaveData()
 		verifyWriteHasData( ii );
 }
 
-void InputData::writeStatement( CodeGenData *cgd, InputLoc &loc, int nargs,
+void InputData::writeStatement( ParseData *pd, InputLoc &loc, int nargs,
 		std::vector<std::string> &args, bool generateDot, const HostLang *hostLang )
 {
+	CodeGenData *cgd = pd->cgd;
+
 	/* Start write generation on a fresh line. */
 	*outStream << '\n';
 
@@ -251,8 +253,32 @@ void InputData::writeStatement( CodeGenData *cgd, InputLoc &loc, int nargs,
 		}
 
 		cgd->collectReferences();
-		cgd->writeData();
+		if ( pd->sharedDefs.size() > 0 )
+			pd->writeSharedActions( *outStream );
+		if ( tableShards > 0 || tableBlob ) {
+			/* Capture the data so the arrays can be moved out. */
+			std::stringstream data;
+			std::streambuf *prev = outStream->rdbuf( data.rdbuf() );
+			cgd->writeData();
+			outStream->rdbuf( prev );
+			if ( tableBlob )
+				blobTables( data.str() );
+			else
+				shardTables( data.str() );
+		}
+		else {
+			cgd->writeData();
+		}
 		cgd->statsSummary();
+
+		if ( pd->eventsWrite != 0 )
+			pd->writeEventData( *outStream );
+		if ( pd->findWriteOption( "exec", "iovec" ) != 0 )
+			pd->writeIovecData( *outStream );
+		if ( pd->prefilterWrite != 0 )
+			pd->writePrefilterData( *outStream );
+		if ( pd->matchActions.size() > 0 )
+			pd->writeMatchData( *outStream );
 	}
 	else if ( args[0] == "init" ) {
 		for ( int i = 1; i < nargs; i++ ) {
@@ -264,14 +290,72 @@ void InputData::writeStatement( CodeGenData *cgd, InputLoc &loc, int nargs,
 		cgd->writeInit();
 	}
 	else if ( args[0] == "exec" ) {
+		bool iovec = false;
 		for ( int i = 1; i < nargs; i++ ) {
 			if ( args[i] == "noend" )
 				cgd->noEnd = true;
+			else if ( args[i] == "events" ) {
+				/* Applied when the machine was prepared. */
+			}
+			else if ( args[i] == "iovec" )
+				iovec = true;
+			else if ( args[i] == "prefilter" ) {
+				/* Applied when the machine was prepared. */
+			}
 			else
 				cgd->write_option_error( loc, args[i] );
 		}
-		cgd->collectReferences();
-		cgd->writeExec();
+
+		if ( iovec ) {
+			if ( hostLang != &hostLangC ) {
+				cgd->red->id->error(loc) << "write exec iovec is only "
+						"supported by the C host language" << std::endl;
+				return;
+			}
+			pd->writeExecIovec( *outStream, loc );
+		}
+		else {
+			cgd->collectReferences();
+			cgd->writeExec();
+		}
+	}
+	else if ( args[0] == "exec_parallel" ) {
+		for ( int i = 1; i < nargs; i++ )
+			cgd->write_option_error( loc, args[i] );
+		pd->writeExecParallel( *outStream, loc );
+	}
+	else if ( args[0] == "exec_bitset" ) {
+		for ( int i = 1; i < nargs; i++ )
+			cgd->write_option_error( loc, args[i] );
+
+		if ( hostLang != &hostLangC ) {
+			cgd->red->id->error(loc) << "write exec_bitset is only "
+					"supported by the C host language" << std::endl;
+			return;
+		}
+		pd->writeExecBitset( *outStream, loc );
+	}
+	else if ( args[0] == "exec_reverse" ) {
+		for ( int i = 1; i < nargs; i++ )
+			cgd->write_option_error( loc, args[i] );
+
+		if ( hostLang != &hostLangC ) {
+			cgd->red->id->error(loc) << "write exec_reverse is only "
+					"supported by the C host language" << std::endl;
+			return;
+		}
+		pd->writeExecReverse( *outStream, loc );
+	}
+	else if ( args[0] == "buffer" ) {
+		for ( int i = 1; i < nargs; i++ )
+			cgd->write_option_error( loc, args[i] );
+
+		if ( hostLang != &hostLangC ) {
+			cgd->red->id->error(loc) << "write buffer is only "
+					"supported by the C host language" << std::endl;
+			return;
+		}
+		pd->writeBuffer( *outStream, loc );
 	}
 	else if ( args[0] == "exports" ) {
 		for ( int i = 1; i < nargs; i++ )
@@ -298,6 +382,17 @@ void InputData::writeStatement( CodeGenData *cgd, InputLoc &loc, int nargs,
 			cgd->write_option_error( loc, args[i] );
 		cgd->writeClear();
 	}
+	else if ( args[0] == "events" ) {
+		for ( int i = 1; i < nargs; i++ )
+			cgd->write_option_error( loc, args[i] );
+
+		if ( pd->eventsWrite == 0 ) {
+			cgd->red->id->error(loc) << "write events requires "
+					"write exec events" << std::endl;
+			return;
+		}
+		pd->writeEventProcess( *outStream );
+	}
 	else {
 		/* EMIT An error here. */
 		cgd->red->id->error(loc) << "unrecognized write command \"" << 
@@ -313,8 +408,7 @@ void InputData::writeOutput( InputItem *ii )
 
 	switch ( ii->type ) {
 		case InputItem::Write: {
-			CodeGenData *cgd = ii->pd->cgd;
-			writeStatement( cgd, ii->loc, ii->writeArgs.size(),
+			writeStatement( ii->pd, ii->loc, ii->writeArgs.size(),
 					ii->writeArgs, generateDot, hostLang );
 			break;
 		}
@@ -351,6 +445,9 @@ void InputData::closeOutput()
 		delete outStream;
 		delete outFilter;
 	}
+
+	closeShards();
+	closeBlob();
 }
 
 void InputData::writeDot( ostream &out )
@@ -704,6 +801,12 @@ void InputData::usage()
 "   --integral-tables    Use integers for table data (default)\n"
 "   --string-tables      Encode table data into strings for faster host lang\n"
 "                        compilation\n"
+"   --table-shards=N     Write the table data of C output to N extra files\n"
+"                        (foo-tab0.c ...) that can be compiled separately\n"
+"   --table-blob         Write the table data of C output to a binary file\n"
+"                        (foo.rlt) included with the assembler's .incbin\n"
+"   --share-actions      Emit identical C action bodies once, as functions\n"
+"                        called from every section that uses them\n"
 "analysis:\n"
 "   --prior-interaction          Search for condition-based general repetitions\n"
 "                                that will not function properly due to state mod\n"
@@ -712,6 +815,12 @@ void InputData::usage()
 "                                of the machine (depth D from start state).\n"
 "   --state-limit=L              Report fail if number of states exceeds this\n"
 "                                during compilation.\n"
+"   --nfa-tune                   Choose the depth of NFA unions by trying\n"
+"                                increasing depths (see -s for the choice).\n"
+"   --backtrack-check            Report fail if a scanner can backtrack over an\n"
+"                                unbounded amount of input (quadratic time).\n"
+"   --pure-scanners              Do not track the token start (ts) in scanners\n"
+"                                that never backtrack, unless actions use it.\n"
 "   --breadth-check=E1,E2,..     Report breadth cost of named entry points and\n"
 "                                the start state.\n"
 "   --input-histogram=FN         Input char histogram for breadth check. If\n"
@@ -1082,6 +1191,26 @@ void InputData::parseArgs( int argc, const char **argv )
 					condsCheckDepth = strtol( eq, 0, 10 );
 				else if ( strcmp( arg, "state-limit" ) == 0 )
 					stateLimit = strtol( eq, 0, 10 );
+				else if ( strcmp( arg, "backtrack-check" ) == 0 )
+					backtrackCheck = true;
+				else if ( strcmp( arg, "pure-scanners" ) == 0 )
+					pureScanners = true;
+				else if ( strcmp( arg, "nfa-tune" ) == 0 )
+					nfaTune = true;
+				else if ( strcmp( arg, "table-shards" ) == 0 ) {
+					char *end = 0;
+					if ( eq != 0 )
+						tableShards = strtol( eq, &end, 10 );
+					if ( eq == 0 || *eq == 0 || *end != 0 || tableShards < 1 ) {
+						error() << "expecting '=N' with N of at least 1 "
+								"for table-shards" << endl;
+						tableShards = 0;
+					}
+				}
+				else if ( strcmp( arg, "table-blob" ) == 0 )
+					tableBlob = true;
+				else if ( strcmp( arg, "share-actions" ) == 0 )
+					shareActions = true;
 
 				else if ( strcmp( arg, "breadth-check" ) == 0 ) {
 					char *ptr = 0;
@@ -1258,6 +1387,18 @@ void InputData::checkArgs()
 	if ( !frontendSpecified )
 		frontend = ReduceBased;
 
+	if ( tableShards > 0 && hostLang != &hostLangC )
+		error() << "--table-shards is only supported by the C host language" << endp;
+
+	if ( tableBlob && hostLang != &hostLangC )
+		error() << "--table-blob is only supported by the C host language" << endp;
+
+	if ( tableBlob && tableShards > 0 )
+		error() << "--table-blob and --table-shards cannot be used together" << endp;
+
+	if ( shareActions && hostLang != &hostLangC )
+		error() << "--share-actions is only supported by the C host language" << endp;
+
 	if ( checkBreadth ) {
 		if ( histogramFn != 0 )
 			loadHistogram();
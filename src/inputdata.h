@@ -28,6 +28,7 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <map>
 
 struct ParseData;
 struct Parser6;
@@ -167,6 +168,19 @@ struct IncludeRec
 
 };
 
+/* An array definition in the text of write data, as the table shards and
+ * blob read it: static const <type> <name>[] = { ... }; */
+struct TableArray
+{
+	std::string type;
+	std::string name;
+
+	/* From the '=' through the line holding "};". */
+	std::string init;
+};
+
+bool readTableArray( std::istream &in, const std::string &line, TableArray &array );
+
 struct InputData
 :
 	public FsmGbl
@@ -205,6 +219,15 @@ struct InputData
 		transSpanDepth(6),
 		stateLimit(0),
 		checkBreadth(0),
+		backtrackCheck(false),
+		pureScanners(false),
+		nfaTune(false),
+		tableShards(0),
+		tableBlob(false),
+		blobStream(0),
+		blobBytes(0),
+		shareActions(false),
+		sharedCounted(false),
 		varBackend(false),
 		histogramFn(0),
 		histogram(0),
@@ -292,6 +315,29 @@ struct InputData
 	long transSpanDepth;
 	long stateLimit;
 	bool checkBreadth;
+	bool backtrackCheck;
+	bool pureScanners;
+	bool nfaTune;
+
+	/* Table data goes to this many extra files, and the bytes written to each. */
+	long tableShards;
+	std::vector<std::ostringstream*> shardStreams;
+	std::vector<long> shardBytes;
+
+	/* Table data goes to a binary file included with .incbin. */
+	bool tableBlob;
+	std::ostream *blobStream;
+	long blobBytes;
+	std::string blobSymbol;
+
+	/* Action bodies shared across sections, by parameter type and text, the
+	 * position in the input items of the write data defining each, and how
+	 * many named actions have each body. */
+	bool shareActions;
+	std::map<std::string, long> sharedBodies;
+	std::vector<long> sharedDefAt;
+	std::map<std::string, long> sharedCounts;
+	bool sharedCounted;
 
 	bool varBackend;
 
@@ -314,13 +360,19 @@ struct InputData
 	void makeTranslateOutputFileName();
 	void flushRemaining();
 	void makeFirstInputItem();
-	void writeStatement( CodeGenData *cgd, InputLoc &loc, int nargs,
+	void writeStatement( ParseData *pd, InputLoc &loc, int nargs,
 		std::vector<std::string> &args, bool generateDot, const HostLang *hostLang );
 	void writeOutput();
 	void makeDefaultFileName();
 	void createOutputStream();
 	void openOutput();
 	void closeOutput();
+	std::string outputSymbol();
+	std::string outputFileWith( const std::string &suffix );
+	void shardTables( const std::string &data );
+	void closeShards();
+	void blobTables( const std::string &data );
+	void closeBlob();
 	void generateReduced();
 	void prepareSingleMachine();
 	void prepareAllMachines();
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Exec over scattered input (write exec iovec). The exec is wrapped in a loop
+ * over the caller's segments:
+ *
+ *     const struct iovec *iov;   the segments
+ *     int iovcnt;                number of segments
+ *     int iov_seg;               segment being processed, start at 0
+ *
+ * p must be null before the first call. It and pe are pointed into each
+ * segment in turn. Positions are carried as (iov_seg, p) pairs. A value that
+ * starts in one segment and ends in a later one is passed to a callback piece
+ * by piece with NAME_iov_span(), which write data emits.
+ *
+ * Scanners backtrack from ts, so a token must be contiguous. The caller also
+ * supplies a carry buffer:
+ *
+ *     T *iov_buf;                room for the longest token
+ *     long iov_buflen;           its length in elements
+ *
+ * When a segment ends inside a token, the token so far is moved to the buffer
+ * and the following input is appended to it until the token is done, when
+ * the machine returns to reading the segment directly. Only tokens that cross
+ * a segment boundary are copied. te is cleared whenever no token is pending,
+ * since it is only read inside the token that set it.
+ */
+
+#include <iostream>
+
+#include <libfsm/ragel.h>
+#include <libfsm/redfsm.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+static std::string alphPtrType( HostType *alphType )
+{
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+	return alph + " *";
+}
+
+bool ParseData::iovecCheck( const InputLoc &loc )
+{
+	if ( fsmCtx->pExpr != 0 || fsmCtx->peExpr != 0 ) {
+		id->error( loc ) << "write exec iovec requires the default "
+				"p and pe variables" << endl;
+		return false;
+	}
+
+	if ( lmList.length() > 0 && ( fsmCtx->eofExpr != 0 ||
+			fsmCtx->tokstartExpr != 0 || fsmCtx->tokendExpr != 0 ) )
+	{
+		id->error( loc ) << "write exec iovec with a scanner requires the "
+				"default eof, ts and te variables" << endl;
+		return false;
+	}
+
+	return true;
+}
+
+void ParseData::writeIovecData( std::ostream &out )
+{
+	std::string alph = alphPtrType( alphType );
+
+	out <<
+		"static void " << sectionName << "_iov_span( const struct iovec *iov,\n"
+		"		int seg0, " << alph << "p0, int seg1, " << alph << "p1,\n"
+		"		void (*piece)( " << alph << "p, " << alph << "pe, void *ctx ), void *ctx )\n"
+		"{\n"
+		"	while ( seg0 < seg1 ) {\n"
+		"		" << alph << "end = (" << alph << ")iov[seg0].iov_base + iov[seg0].iov_len;\n"
+		"		if ( p0 < end )\n"
+		"			piece( p0, end, ctx );\n"
+		"		seg0 += 1;\n"
+		"		p0 = (" << alph << ")iov[seg0].iov_base;\n"
+		"	}\n"
+		"	if ( p0 < p1 )\n"
+		"		piece( p0, p1, ctx );\n"
+		"}\n"
+		"\n";
+}
+
+void ParseData::writeExecIovec( std::ostream &out, const InputLoc &loc )
+{
+	if ( !iovecCheck( loc ) )
+		return;
+
+	std::string alph = alphPtrType( alphType );
+
+	/* The state variable, as the exec code refers to it. */
+	std::string cs = "cs";
+	if ( fsmCtx->csExpr != 0 || fsmCtx->accessExpr != 0 ) {
+		InlineList *expr = fsmCtx->csExpr != 0 ? fsmCtx->csExpr : fsmCtx->accessExpr;
+		std::string text;
+		for ( InlineList::Iter item = *expr; item.lte(); item++ ) {
+			if ( item->type == InlineItem::Text )
+				text += item->data;
+		}
+		cs = fsmCtx->csExpr != 0 ? "(" + text + ")" : text + "cs";
+	}
+
+	if ( lmList.length() > 0 ) {
+		writeExecIovecScanner( out, cs );
+		return;
+	}
+
+	out <<
+		"while ( iov_seg < iovcnt ) {\n"
+		"	if ( p == 0 ) {\n"
+		"		p = (" << alph << ")iov[iov_seg].iov_base;\n"
+		"		pe = p + iov[iov_seg].iov_len;\n"
+		"	}\n"
+		"\n";
+
+	cgd->collectReferences();
+	cgd->writeExec();
+
+	out <<
+		"\n"
+		"	/* Stopped inside the segment: a break or an error. */\n"
+		"	if ( p != pe";
+	if ( cgd->redFsm->errState != 0 )
+		out << " || " << cs << " == " << cgd->redFsm->errState->id;
+	out << " )\n"
+		"		break;\n"
+		"\n"
+		"	iov_seg += 1;\n"
+		"	p = 0;\n"
+		"}\n";
+}
+
+/* A pending token is kept contiguous in iov_buf. _iov_off is the next element
+ * of the current segment not yet given to the machine, _iov_have the number of
+ * elements of the pending token at the start of the buffer and _iov_n the
+ * number appended after them for this run. _iov_te is te as an offset from ts
+ * while the token is moved, or -1 if the token has not set it. */
+void ParseData::writeExecIovecScanner( std::ostream &out, const std::string &cs )
+{
+	std::string alph = alphPtrType( alphType );
+
+	out <<
+		"{\n"
+		"	" << alph << "_iov_eof = eof;\n"
+		"	" << alph << "_iov_base;\n"
+		"	long _iov_off = 0, _iov_have = 0, _iov_n = 0, _iov_te;\n"
+		"\n"
+		"	/* Resuming after a break inside a segment. */\n"
+		"	if ( p != 0 && iov_seg < iovcnt )\n"
+		"		_iov_off = p - (" << alph << ")iov[iov_seg].iov_base;\n"
+		"\n"
+		"	while ( iov_seg < iovcnt ) {\n"
+		"		_iov_base = (" << alph << ")iov[iov_seg].iov_base;\n"
+		"		if ( _iov_have == 0 ) {\n"
+		"			te = 0;\n"
+		"			_iov_n = 0;\n"
+		"			p = _iov_base + _iov_off;\n"
+		"			pe = _iov_base + iov[iov_seg].iov_len;\n"
+		"			_iov_off = iov[iov_seg].iov_len;\n"
+		"		}\n"
+		"		else {\n"
+		"			_iov_n = iov[iov_seg].iov_len - _iov_off;\n"
+		"			if ( _iov_n > iov_buflen - _iov_have )\n"
+		"				_iov_n = iov_buflen - _iov_have;\n"
+		"			memcpy( iov_buf + _iov_have, _iov_base + _iov_off, _iov_n * sizeof(*p) );\n"
+		"			p = iov_buf + _iov_have;\n"
+		"			pe = p + _iov_n;\n"
+		"			_iov_off += _iov_n;\n"
+		"		}\n"
+		"\n"
+		"		/* The end of the last segment is the end of the input. */\n"
+		"		eof = 0;\n"
+		"		if ( _iov_eof != 0 && iov_seg == iovcnt - 1 &&\n"
+		"				_iov_off == (long)iov[iov_seg].iov_len )\n"
+		"			eof = pe;\n"
+		"\n";
+
+	cgd->collectReferences();
+	cgd->writeExec();
+
+	out <<
+		"\n"
+		"		/* Stopped early: a break or an error. Point p back into the\n"
+		"		 * segment unless it is inside the carried part of a token. */\n"
+		"		if ( p != pe";
+	if ( cgd->redFsm->errState != 0 )
+		out << " || " << cs << " == " << cgd->redFsm->errState->id;
+	out << " ) {\n"
+		"			if ( _iov_have > 0 && p >= iov_buf + _iov_have )\n"
+		"				p = _iov_base + ( _iov_off - _iov_n ) + ( p - ( iov_buf + _iov_have ) );\n"
+		"			break;\n"
+		"		}\n"
+		"\n"
+		"		/* Carry a pending token, leaving room for more of it. A token\n"
+		"		 * that fills the buffer stops the machine with p null. */\n"
+		"		_iov_have = 0;\n"
+		"		if ( ts != 0 ) {\n"
+		"			if ( pe - ts >= iov_buflen ) {\n"
+		"				p = 0;\n"
+		"				break;\n"
+		"			}\n"
+		"			/* te is null or in the same run as ts. */\n"
+		"			_iov_te = te != 0 && te >= ts ? te - ts : -1;\n"
+		"			_iov_have = pe - ts;\n"
+		"			memmove( iov_buf, ts, _iov_have * sizeof(*p) );\n"
+		"			te = _iov_te >= 0 ? iov_buf + _iov_te : 0;\n"
+		"			ts = iov_buf;\n"
+		"		}\n"
+		"\n"
+		"		if ( _iov_off == (long)iov[iov_seg].iov_len ) {\n"
+		"			iov_seg += 1;\n"
+		"			_iov_off = 0;\n"
+		"			p = 0;\n"
+		"		}\n"
+		"	}\n"
+		"	eof = _iov_eof;\n"
+		"}\n";
+}
@@ -26,6 +26,8 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <map>
+#include <vector>
 #include <inputdata.h>
 
 /* Parsing. */
@@ -33,6 +35,172 @@
 #include "parsetree.h"
 #include "parsedata.h"
 
+using std::endl;
+
+/* The targets of a state's transitions that are not final. */
+static void overshootTargets( StateAp *state, std::vector<StateAp*> &targs )
+{
+	for ( TransList::Iter trans = state->outList; trans.lte(); trans++ ) {
+		if ( trans->plain() ) {
+			StateAp *targ = trans->tdap()->toState;
+			if ( targ != 0 && !targ->isFinState() )
+				targs.push_back( targ );
+		}
+		else {
+			for ( CondList::Iter cond = trans->tcap()->condList; cond.lte(); cond++ ) {
+				StateAp *targ = cond->toState;
+				if ( targ != 0 && !targ->isFinState() )
+					targs.push_back( targ );
+			}
+		}
+	}
+}
+
+struct OvershootFrame
+{
+	StateAp *state;
+	std::vector<StateAp*> targs;
+	size_t next;
+	long max;
+};
+
+/* Longest run of characters that can be read from the state without passing
+ * through a final state. Returns -1 if the run can be unbounded. Depth first,
+ * with an explicit stack so that long chains of states cannot overflow the
+ * call stack. */
+static long overshootDepth( StateAp *state, std::map<StateAp*, long> &depth )
+{
+	std::map<StateAp*, long>::iterator d = depth.find( state );
+	if ( d != depth.end() )
+		return d->second;
+
+	std::vector<OvershootFrame> stack( 1 );
+	stack.back().state = state;
+	stack.back().next = 0;
+	stack.back().max = 0;
+	overshootTargets( state, stack.back().targs );
+
+	/* -2 marks a state on the current path. */
+	depth[state] = -2;
+
+	while ( true ) {
+		OvershootFrame &top = stack.back();
+		if ( top.next < top.targs.size() ) {
+			StateAp *targ = top.targs[top.next++];
+
+			long sub;
+			d = depth.find( targ );
+			if ( d == depth.end() ) {
+				depth[targ] = -2;
+				stack.push_back( OvershootFrame() );
+				stack.back().state = targ;
+				stack.back().next = 0;
+				stack.back().max = 0;
+				overshootTargets( targ, stack.back().targs );
+				continue;
+			}
+
+			sub = d->second == -2 ? -1 : d->second;
+			if ( sub < 0 ) {
+				/* Everything on the path reaches the loop. */
+				for ( size_t s = 0; s < stack.size(); s++ )
+					depth[stack[s].state] = -1;
+				return -1;
+			}
+
+			if ( sub + 1 > top.max )
+				top.max = sub + 1;
+		}
+		else {
+			long done = top.max;
+			depth[top.state] = done;
+			stack.pop_back();
+			if ( stack.empty() )
+				return done;
+
+			if ( done + 1 > stack.back().max )
+				stack.back().max = done + 1;
+		}
+	}
+}
+
+/* How far the scanner can read past the end of the last token matched before
+ * it fails and has to go back to the token end. The characters are read again
+ * for the next token, so when this is unbounded an input of n characters can
+ * take time proportional to n squared. Returns -1 for unbounded. */
+long LongestMatch::backtrackBound( FsmAp *graph )
+{
+	std::map<StateAp*, long> depth;
+	long bound = 0;
+
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		if ( st->isFinState() ) {
+			long sub = overshootDepth( st, depth );
+			if ( sub < 0 )
+				return -1;
+			if ( sub > bound )
+				bound = sub;
+		}
+	}
+
+	return bound;
+}
+
+void LongestMatch::checkBacktrack( ParseData *pd, FsmAp *graph )
+{
+	long bound = backtrackBound( graph );
+
+	if ( pd->id->printStatistics ) {
+		if ( bound < 0 )
+			pd->id->stats() << "scanner-backtrack\tunbounded" << endl;
+		else
+			pd->id->stats() << "scanner-backtrack\t" << bound << endl;
+	}
+
+	if ( bound < 0 && pd->id->backtrackCheck ) {
+		pd->id->error( loc ) << "scanner can backtrack over an unbounded "
+				"amount of input, worst-case time is quadratic" << endl;
+	}
+}
+
+static bool identUsed( InlineList *inlineList, const char *ident )
+{
+	for ( InlineList::Iter item = *inlineList; item.lte(); item++ ) {
+		if ( item->type == InlineItem::Text && item->data == ident )
+			return true;
+		if ( item->children != 0 && identUsed( item->children, ident ) )
+			return true;
+	}
+	return false;
+}
+
+/* Does any user action refer to the token start? Identifiers are separate
+ * text items, so this finds direct references only. The scanner's own actions
+ * are made of statement items with no text, so every action can be searched.
+ * Token actions are marked isLmAction like the generated ones, and are
+ * searched through the scanner parts as well. */
+bool LongestMatch::tokStartUsed( ParseData *pd )
+{
+	if ( pd->fsmCtx->tokstartExpr != 0 )
+		return true;
+
+	for ( ActionList::Iter act = pd->fsmCtx->actionList; act.lte(); act++ ) {
+		if ( act->inlineList != 0 && identUsed( act->inlineList, "ts" ) )
+			return true;
+	}
+
+	for ( LmList::Iter lm = pd->lmList; lm.lte(); lm++ ) {
+		for ( LongestMatchPart *lmPart = lm->longestMatchList->head;
+				lmPart != 0; lmPart = lmPart->next )
+		{
+			if ( lmPart->action != 0 && lmPart->action->inlineList != 0 &&
+					identUsed( lmPart->action->inlineList, "ts" ) )
+				return true;
+		}
+	}
+	return false;
+}
+
 void LongestMatch::runLongestMatch( ParseData *pd, FsmAp *graph )
 {
 	graph->markReachableFromHereStopFinal( graph->startState );
@@ -113,11 +281,27 @@ void LongestMatch::runLongestMatch( ParseData *pd, FsmAp *graph )
 		}
 	}
 
-	/* The actions executed on starting to match a token. */
+	/* If no state past a match can go on to a longer one, the scanner never
+	 * backtracks and every token is recognized on its last character. */
+	bool pureDfa = true;
+	for ( StateList::Iter ms = graph->stateList; ms.lte(); ms++ ) {
+		for ( LmItemSet::Iter plmi = ms->lmItemSet; plmi.lte(); plmi++ ) {
+			if ( *plmi != 0 )
+				pureDfa = false;
+		}
+	}
+
+	if ( pd->id->printStatistics )
+		pd->id->stats() << "scanner-pure-dfa\t" << ( pureDfa ? 1 : 0 ) << endl;
+
+	/* The actions executed on starting to match a token. A pure DFA does not
+	 * need the token start, unless the user code reads it. */
 	FsmRes res = FsmAp::isolateStartState( graph );
 	graph = res.fsm;
-	graph->startState->toStateActionTable.setAction( pd->initTokStartOrd, pd->initTokStart );
-	graph->startState->fromStateActionTable.setAction( pd->setTokStartOrd, pd->setTokStart );
+	if ( !pureDfa || !pd->id->pureScanners || tokStartUsed( pd ) ) {
+		graph->startState->toStateActionTable.setAction( pd->initTokStartOrd, pd->initTokStart );
+		graph->startState->fromStateActionTable.setAction( pd->setTokStartOrd, pd->setTokStart );
+	}
 	if ( maxItemSetLength > 1 ) {
 		/* The longest match action switch may be called when tokens are
 		 * matched, in which case act must be initialized, there must be a
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Match sets. :match( id, expr ): tags the final states of expr with the
+ * pattern id. While the machine is built the tag is an EOF action that stands
+ * for the id, so union, determinization and minimization carry it along and
+ * keep states with different sets apart. Once the machine is complete the
+ * markers are taken out of the states and kept as a set of ids per final
+ * state. No code is generated for them. write data emits the sets as a table
+ * indexed by the current state.
+ */
+
+#include <iostream>
+#include <algorithm>
+
+#include <libfsm/ragel.h>
+#include <libfsm/redfsm.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+FsmRes Factor::walkMatch( ParseData *pd )
+{
+	FsmRes exprTree = expression->walk( pd );
+	if ( !exprTree.success() )
+		return exprTree;
+
+	exprTree.fsm->finalEOFAction( pd->fsmCtx->curActionOrd++,
+			pd->matchAction( loc, repId ) );
+	return exprTree;
+}
+
+/* One marker per id, shared by all the patterns given that id. */
+Action *ParseData::matchAction( const InputLoc &loc, long matchId )
+{
+	std::map<long, Action*>::iterator m = matchActions.find( matchId );
+	if ( m != matchActions.end() )
+		return m->second;
+
+	Action *action = new Action( loc, "match", new InlineList, fsmCtx->nextCondId++ );
+	action->embedRoots.append( rootName );
+	fsmCtx->actionList.append( action );
+
+	matchActions[matchId] = action;
+	matchIds[action] = matchId;
+	return action;
+}
+
+/* Called after the graph is built, before analysis and reduction. */
+void ParseData::makeMatchSets( FsmAp *graph, const HostLang *hostLang )
+{
+	if ( hostLang != &hostLangC ) {
+		id->error( matchActions.begin()->second->loc ) << "match sets are only "
+				"supported by the C host language" << endl;
+		return;
+	}
+
+	long total = 0;
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		ActionTable kept;
+		std::vector<long> ids;
+		for ( ActionTable::Iter act = st->eofActionTable; act.lte(); act++ ) {
+			std::map<Action*, long>::iterator m = matchIds.find( act->value );
+			if ( m == matchIds.end() )
+				kept.setAction( act->key, act->value );
+			else if ( st->isFinState() )
+				ids.push_back( m->second );
+		}
+
+		if ( kept.length() == st->eofActionTable.length() )
+			continue;
+
+		st->eofActionTable.empty();
+		st->eofActionTable.setActions( kept );
+
+		std::sort( ids.begin(), ids.end() );
+		ids.erase( std::unique( ids.begin(), ids.end() ), ids.end() );
+		if ( ids.size() > 0 ) {
+			matchSets[st] = ids;
+			total += ids.size();
+		}
+	}
+
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-match-states\t" << matchSets.size() << endl;
+		id->stats() << "fsm-match-ids\t" << total << endl;
+	}
+}
+
+/* The ids of all sets in one array, with the offset of each state's set. The
+ * reduced states are allocated in state list order. */
+void ParseData::writeMatchData( std::ostream &out )
+{
+	RedFsmAp *redFsm = cgd->redFsm;
+	long numIds = redFsm->stateList.length();
+	std::vector< const std::vector<long>* > sets( numIds, (const std::vector<long>*)0 );
+
+	long index = 0;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++, index++ ) {
+		std::map< StateAp*, std::vector<long> >::iterator m = matchSets.find( st );
+		if ( m != matchSets.end() )
+			sets[redFsm->allStates[index].id] = &m->second;
+	}
+
+	std::string name = sectionName;
+
+	out << "static const int " << name << "_match_ids[] = {\n\t";
+	long offset = 0;
+	std::vector<long> offsets;
+	for ( long s = 0; s < numIds; s++ ) {
+		offsets.push_back( offset );
+		if ( sets[s] != 0 ) {
+			for ( size_t i = 0; i < sets[s]->size(); i++ )
+				out << (*sets[s])[i] << ", ";
+			offset += sets[s]->size();
+		}
+	}
+	offsets.push_back( offset );
+	if ( offset == 0 )
+		out << "0";
+
+	out << "\n};\n"
+		"\n"
+		"static const int " << name << "_match_offsets[] = {\n\t";
+	for ( size_t o = 0; o < offsets.size(); o++ ) {
+		out << offsets[o] << ", ";
+		if ( o % 16 == 15 )
+			out << "\n\t";
+	}
+	out << "\n};\n"
+		"\n"
+		"/* The ids of the patterns accepted in state cs, in increasing order. */\n"
+		"static int " << name << "_matches( int cs, const int **ids )\n"
+		"{\n"
+		"	*ids = " << name << "_match_ids + " << name << "_match_offsets[cs];\n"
+		"	return " << name << "_match_offsets[cs + 1] - " << name << "_match_offsets[cs];\n"
+		"}\n"
+		"\n";
+}
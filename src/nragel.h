@@ -38,6 +38,9 @@ struct HostLang
 	GenLineDirectiveT genLineDirective;
 };
 
+/* The C host. Ragel proper generates code for it directly. */
+extern "C" const HostLang hostLangC;
+
 void genLineDirectiveC( std::ostream &out, bool nld, int line, const char *file );
 void genLineDirectiveAsm( std::ostream &out, bool nld, int line, const char *file );
 void genLineDirectiveTrans( std::ostream &out, bool nld, int line, const char *file );
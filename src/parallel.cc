@@ -0,0 +1,250 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Speculative parallel exec (write exec_parallel). The input is cut into
+ * chunks. The first chunk runs from the real current state. Every other chunk
+ * runs from each state it could possibly start in, giving a map from start
+ * state to end state. A sequential pass then follows the real state through
+ * the maps. The chunks are independent, so a caller-supplied pool can run
+ * them on all cores.
+ *
+ * The states a chunk can start in are found by convergence: starting from the
+ * set of all states, repeatedly take the set of states reachable in one
+ * character. After k characters the machine can only be in the k-th set, which
+ * for most machines shrinks to a handful of states quickly. A state outside
+ * the set (a very short first chunk) is handled by running the chunk again.
+ */
+
+#include <iostream>
+#include <set>
+#include <algorithm>
+
+#include <libfsm/ragel.h>
+#include <libfsm/redfsm.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+/* How far to follow the convergence before settling on the current set. */
+#define PAR_MAX_DEPTH 64
+
+typedef std::set<StateAp*> ParStateSet;
+
+/* States reachable from the set in one character. The error state is
+ * represented by null. */
+static void parImage( KeyOps *keyOps, const ParStateSet &from, ParStateSet &to )
+{
+	unsigned long long alphSpan = keyOps->span( keyOps->minKey, keyOps->maxKey );
+
+	for ( ParStateSet::const_iterator s = from.begin(); s != from.end(); s++ ) {
+		StateAp *st = *s;
+		if ( st == 0 ) {
+			to.insert( 0 );
+			continue;
+		}
+
+		unsigned long long covered = 0;
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			covered += keyOps->span( trans->lowKey, trans->highKey );
+			to.insert( trans->tdap()->toState );
+		}
+
+		if ( covered < alphSpan )
+			to.insert( 0 );
+	}
+}
+
+/* Check the machine can be run speculatively. Nothing it does may be visible
+ * outside of the state variable. */
+bool ParseData::parallelCheck( const InputLoc &loc )
+{
+	if ( fsmCtx->accessExpr != 0 || fsmCtx->pExpr != 0 || fsmCtx->peExpr != 0 ||
+			fsmCtx->csExpr != 0 || fsmCtx->eofExpr != 0 || fsmCtx->getKeyExpr != 0 )
+	{
+		id->error( loc ) << "write exec_parallel requires the default "
+				"p, pe, cs and eof variables (no access, variable or "
+				"getkey statements)" << endl;
+		return false;
+	}
+
+	if ( lmList.length() > 0 ) {
+		id->error( loc ) << "write exec_parallel cannot be used with scanners" << endl;
+		return false;
+	}
+
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		bool actions = st->toStateActionTable.length() > 0 ||
+				st->fromStateActionTable.length() > 0 ||
+				st->eofActionTable.length() > 0;
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( !trans->plain() ) {
+				id->error( loc ) << "write exec_parallel cannot be used "
+						"with conditions" << endl;
+				return false;
+			}
+			if ( trans->tdap()->actionTable.length() > 0 )
+				actions = true;
+		}
+
+		if ( actions ) {
+			id->error( loc ) << "write exec_parallel requires a machine "
+					"without actions" << endl;
+			return false;
+		}
+
+		if ( st->nfaOut != 0 ) {
+			id->error( loc ) << "write exec_parallel cannot be used "
+					"with NFA constructions" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ParseData::writeExecParallel( std::ostream &out, const InputLoc &loc )
+{
+	if ( !parallelCheck( loc ) )
+		return;
+
+	/* Converge. */
+	ParStateSet cur;
+	cur.insert( 0 );
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ )
+		cur.insert( st );
+
+	int depth = 0;
+	while ( depth < PAR_MAX_DEPTH ) {
+		ParStateSet next;
+		parImage( fsmCtx->keyOps, cur, next );
+		if ( next.size() == cur.size() )
+			break;
+		cur = next;
+		depth += 1;
+	}
+
+	/* The reduced states are allocated in state list order. Map to the final
+	 * state ids. */
+	std::vector<int> cands;
+	long index = 0;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++, index++ ) {
+		if ( cur.find( st ) != cur.end() )
+			cands.push_back( cgd->redFsm->allStates[index].id );
+	}
+	if ( cur.find( 0 ) != cur.end() && cgd->redFsm->errState != 0 )
+		cands.push_back( cgd->redFsm->errState->id );
+	std::sort( cands.begin(), cands.end() );
+
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-par-depth\t" << depth << endl;
+		id->stats() << "fsm-par-states\t" << cands.size() << endl;
+	}
+
+	std::string name = sectionName;
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+	size_t ncands = cands.size() > 0 ? cands.size() : 1;
+
+	out << "static const int " << name << "_par_states[] = { ";
+	for ( size_t c = 0; c < cands.size(); c++ )
+		out << cands[c] << ", ";
+	out << "-1 };\n"
+		"\n"
+		"struct " << name << "_par_job\n"
+		"{\n"
+		"	" << alph << " *p;\n"
+		"	" << alph << " *pe;\n"
+		"	int out[" << ncands << "];\n"
+		"};\n"
+		"\n"
+		"static int " << name << "_par_run( int cs, " << alph << " *p, " << alph << " *pe )\n"
+		"{\n"
+		"	" << alph << " *eof = 0;\n";
+
+	/* The user may have asked for noend on their own exec. */
+	bool noEnd = cgd->noEnd;
+	cgd->noEnd = false;
+	cgd->collectReferences();
+	cgd->writeExec();
+	cgd->noEnd = noEnd;
+
+	out <<
+		"\n"
+		"	(void)eof;\n"
+		"	return cs;\n"
+		"}\n"
+		"\n"
+		"static void " << name << "_par_work( void *ctx, int i )\n"
+		"{\n"
+		"	struct " << name << "_par_job *job = (struct " << name << "_par_job*)ctx + i;\n"
+		"	int s;\n"
+		"	if ( i == 0 )\n"
+		"		job->out[0] = " << name << "_par_run( job->out[0], job->p, job->pe );\n"
+		"	else {\n"
+		"		for ( s = 0; " << name << "_par_states[s] >= 0; s++ )\n"
+		"			job->out[s] = " << name << "_par_run( " << name << "_par_states[s], job->p, job->pe );\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"static int " << name << "_exec_parallel( int cs, " << alph << " *p, " << alph << " *pe,\n"
+		"		struct " << name << "_par_job *jobs, int njobs,\n"
+		"		void (*pool)( void (*work)( void *ctx, int i ), void *ctx, int n ) )\n"
+		"{\n"
+		"	long chunk = ( pe - p ) / ( njobs > 0 ? njobs : 1 );\n"
+		"	int i, s;\n"
+		"\n"
+		"	if ( njobs < 2 || chunk == 0 )\n"
+		"		return " << name << "_par_run( cs, p, pe );\n"
+		"\n"
+		"	for ( i = 0; i < njobs; i++ ) {\n"
+		"		jobs[i].p = p + chunk * i;\n"
+		"		jobs[i].pe = i == njobs - 1 ? pe : p + chunk * ( i + 1 );\n"
+		"	}\n"
+		"	jobs[0].out[0] = cs;\n"
+		"\n"
+		"	if ( pool != 0 )\n"
+		"		pool( " << name << "_par_work, jobs, njobs );\n"
+		"	else {\n"
+		"		for ( i = 0; i < njobs; i++ )\n"
+		"			" << name << "_par_work( jobs, i );\n"
+		"	}\n"
+		"\n"
+		"	cs = jobs[0].out[0];\n"
+		"	for ( i = 1; i < njobs; i++ ) {\n"
+		"		for ( s = 0; " << name << "_par_states[s] >= 0; s++ ) {\n"
+		"			if ( " << name << "_par_states[s] == cs )\n"
+		"				break;\n"
+		"		}\n"
+		"\n"
+		"		if ( " << name << "_par_states[s] >= 0 )\n"
+		"			cs = jobs[i].out[s];\n"
+		"		else\n"
+		"			cs = " << name << "_par_run( cs, jobs[i].p, jobs[i].pe );\n"
+		"	}\n"
+		"	return cs;\n"
+		"}\n";
+}
@@ -30,6 +30,7 @@
 #include <libfsm/ragel.h>
 #include "parsedata.h"
 #include "parsetree.h"
+#include "tablayout.h"
 #include "mergesort.h"
 #include "version.h"
 #include "inputdata.h"
@@ -441,7 +442,11 @@ ParseData::ParseData( InputData *id, string sectionName,
 	nextEpsilonResolvedLink(0),
 	nextLongestMatchId(1),
 	nextRepId(1),
-	cgd(0)
+	cgd(0),
+	eventsWrite(0),
+	eventReserve(0),
+	prefilterWrite(0),
+	prefilterStates(0)
 {
 	fsmCtx = new FsmCtx( id );
 
@@ -1436,6 +1441,36 @@ FsmRes ParseData::prepareMachineGen( GraphDictEl *graphDictEl, const HostLang *h
 	if ( id->errorCount > 0 )
 		return FsmRes( FsmRes::InternalError() );
 
+	/* Pattern ids move from marker actions to match sets, leaving no
+	 * actions behind. Must precede the analysis. */
+	if ( matchActions.size() > 0 ) {
+		makeMatchSets( sectionGraph, hostLang );
+		if ( id->errorCount > 0 )
+			return FsmRes( FsmRes::InternalError() );
+	}
+
+	/* Actions become appends to the event log. Must precede the analysis,
+	 * which counts the action references. */
+	eventsWrite = findWriteOption( "exec", "events" );
+	if ( eventsWrite != 0 ) {
+		makeEventLog( sectionGraph, hostLang );
+		if ( id->errorCount > 0 )
+			return FsmRes( FsmRes::InternalError() );
+	}
+
+	/* Skips are from-state actions. Also must precede the analysis. */
+	prefilterWrite = findWriteOption( "exec", "prefilter" );
+	if ( prefilterWrite != 0 ) {
+		makePrefilter( sectionGraph, hostLang );
+		if ( id->errorCount > 0 )
+			return FsmRes( FsmRes::InternalError() );
+	}
+
+	/* Action bodies become calls to functions shared by all sections. After
+	 * the event log, whose appends cannot be shared. */
+	if ( id->shareActions )
+		makeSharedActions( sectionGraph, hostLang );
+
 	fsmCtx->analyzeGraph( sectionGraph );
 
 	/* Depends on the graph analysis. */
@@ -1463,6 +1498,14 @@ void ParseData::generateReduced( const char *inputFileName, CodeStyle codeStyle,
 
 	/* Code generation anlysis step. */
 	cgd->genAnalysis();
+
+	if ( id->printStatistics ) {
+		TableLayout layout( fsmCtx, sectionGraph );
+		layout.analyze();
+		layout.combVector();
+		layout.packedTables();
+		layout.writeStats( id->stats() );
+	}
 }
 
 #if 0
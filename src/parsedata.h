@@ -28,6 +28,7 @@
 #include <sstream>
 #include <vector>
 #include <set>
+#include <map>
 
 #include "avlmap.h"
 #include "bstmap.h"
@@ -58,6 +59,7 @@ struct Literal;
 struct Range;
 struct RegExpr;
 struct ReItem;
+struct InputItem;
 struct ReOrBlock;
 struct ReOrItem;
 struct LongestMatch;
@@ -340,6 +342,74 @@ struct ParseData
 		int entryId;
 	};
 
+	/* Event log exec: the write statement that requested it, the actions
+	 * given event ids (with their original bodies) and the number of free
+	 * buffer slots needed to process one character. */
+	struct EventAction
+	{
+		EventAction( Action *action, InlineList *body )
+			: action(action), body(body) {}
+
+		Action *action;
+		InlineList *body;
+	};
+
+	InputItem *eventsWrite;
+	std::vector<EventAction> eventActions;
+	long eventReserve;
+
+	InputItem *findWriteOption( const char *cmd, const char *opt );
+	InlineList *eventAppend( const InputLoc &loc, long eventId, bool canBreak );
+	void makeEventLog( FsmAp *graph, const HostLang *hostLang );
+	void writeEventData( std::ostream &out );
+	void writeEventProcess( std::ostream &out );
+
+	bool parallelCheck( const InputLoc &loc );
+	void writeExecParallel( std::ostream &out, const InputLoc &loc );
+
+	bool iovecCheck( const InputLoc &loc );
+	void writeIovecData( std::ostream &out );
+	void writeExecIovec( std::ostream &out, const InputLoc &loc );
+	void writeExecIovecScanner( std::ostream &out, const std::string &cs );
+
+	bool bitsetCheck( const InputLoc &loc );
+	void writeExecBitset( std::ostream &out, const InputLoc &loc );
+
+	bool reverseCheck( const InputLoc &loc );
+	void writeExecReverse( std::ostream &out, const InputLoc &loc );
+
+	/* Literal prefilter: the write statement that requested it, the literals
+	 * skipped to and the number of search states given a skip. */
+	InputItem *prefilterWrite;
+	std::vector< std::vector<Key> > prefilterLits;
+	long prefilterStates;
+
+	void makePrefilter( FsmAp *graph, const HostLang *hostLang );
+	void writePrefilterData( std::ostream &out );
+
+	/* Match sets: the marker action standing for each pattern id while the
+	 * machine is built, and the ids accepted in each final state after. */
+	std::map<long, Action*> matchActions;
+	std::map<Action*, long> matchIds;
+	std::map< StateAp*, std::vector<long> > matchSets;
+
+	Action *matchAction( const InputLoc &loc, long matchId );
+	void makeMatchSets( FsmAp *graph, const HostLang *hostLang );
+	void writeMatchData( std::ostream &out );
+
+	/* The store action of each capture register. */
+	std::map<long, Action*> captureActions;
+
+	Action *captureAction( const InputLoc &loc, long reg );
+
+	void writeBuffer( std::ostream &out, const InputLoc &loc );
+
+	/* Definitions of the shared action bodies this section used first. */
+	std::vector<std::string> sharedDefs;
+
+	void makeSharedActions( FsmAp *graph, const HostLang *hostLang );
+	void writeSharedActions( std::ostream &out );
+
 	/* Track the cuts we set in the fsm graph. We perform cost analysis on the
 	 * built fsm graph for each of these entry points. */
 	Vector<Cut> cuts;
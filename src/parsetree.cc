@@ -38,6 +38,12 @@ using namespace std;
 ostream &operator<<( ostream &out, const NameRef &nameRef );
 ostream &operator<<( ostream &out, const NameInst &nameInst );
 
+/* NFA union tuning: the deepest single round tried, the states allowed when
+ * no state limit is given, and the cost of an NFA transition in states. */
+#define NFA_TUNE_MAX_DEPTH 256
+#define NFA_TUNE_STATE_BUDGET 200000
+#define NFA_TUNE_BRANCH_COST 32
+
 /* Read string literal (and regex) options and return the true end. */
 const char *checkLitOptions( InputData *id, const InputLoc &loc,
 		const char *data, int length, bool &caseInsensitive )
@@ -454,6 +460,7 @@ FsmRes LongestMatch::walkClassic( ParseData *pd )
 			return res;
 	}
 
+	checkBacktrack( pd, res.fsm );
 	runLongestMatch( pd, res.fsm );
 
 	/* Pop the name scope. */
@@ -504,9 +511,89 @@ FsmRes NfaUnion::walk( ParseData *pd )
 	std::ostream &stats = pd->id->stats();
 	bool printStatistics = pd->id->printStatistics;
 
+	if ( pd->id->nfaTune )
+		return tuneRounds( pd, machines, numMachines );
+
 	return FsmAp::nfaUnion( *roundsList, machines, numMachines, stats, printStatistics );
 }
 
+/* Build the union with a single round of depth 1, 2, 4, ... and keep the one
+ * with the lowest cost. The cost counts each state, plus a fixed amount for
+ * each NFA transition, standing in for the backtracking it may cause. Stops
+ * when the depth goes beyond the machine, the result is a DFA or the state
+ * budget is exceeded. */
+FsmRes NfaUnion::tuneRounds( ParseData *pd, FsmAp **machines, long numMachines )
+{
+	std::ostream &stats = pd->id->stats();
+	bool printStatistics = pd->id->printStatistics;
+
+	long stateLimit = pd->fsmCtx->stateLimit;
+	if ( pd->id->stateLimit <= 0 )
+		pd->fsmCtx->stateLimit = NFA_TUNE_STATE_BUDGET;
+
+	long groups = (*roundsList)[0].groups;
+	FsmRes best( FsmRes::InternalError() );
+	long bestCost = 0, bestDepth = 0, prevStates = -1;
+
+	for ( long depth = 1; depth <= NFA_TUNE_MAX_DEPTH; depth *= 2 ) {
+		NfaRoundVect rounds;
+		rounds.append( NfaRound( depth, groups ) );
+
+		FsmAp **copies = new FsmAp*[numMachines];
+		for ( int m = 0; m < numMachines; m++ )
+			copies[m] = new FsmAp( *machines[m] );
+
+		FsmRes res = FsmAp::nfaUnion( rounds, copies, numMachines, stats, false );
+		if ( !res.success() ) {
+			if ( printStatistics )
+				stats << "nfa tune\t" << depth << "," << groups << "\tfailed" << endl;
+			break;
+		}
+
+		long states = res.fsm->stateList.length(), nfaTrans = 0;
+		for ( StateList::Iter st = res.fsm->stateList; st.lte(); st++ ) {
+			if ( st->nfaOut != 0 )
+				nfaTrans += st->nfaOut->length();
+		}
+		long cost = states + NFA_TUNE_BRANCH_COST * nfaTrans;
+
+		if ( printStatistics ) {
+			stats << "nfa tune\t" << depth << "," << groups << "\t" <<
+					states << "\t" << nfaTrans << "\t" << cost << endl;
+		}
+
+		if ( !best.success() || cost < bestCost ) {
+			if ( best.success() )
+				delete best.fsm;
+			best = res;
+			bestCost = cost;
+			bestDepth = depth;
+		}
+		else {
+			delete res.fsm;
+		}
+
+		if ( nfaTrans == 0 || states == prevStates )
+			break;
+		prevStates = states;
+	}
+
+	pd->fsmCtx->stateLimit = stateLimit;
+
+	for ( int m = 0; m < numMachines; m++ )
+		delete machines[m];
+	delete[] machines;
+
+	if ( !best.success() )
+		return FsmRes( FsmRes::TooManyStates() );
+
+	/* The schedule to pin in the source for a reproducible build. */
+	if ( printStatistics )
+		stats << "nfa rounds\t" << bestDepth << "," << groups << endl;
+
+	return best;
+}
+
 void NfaUnion::makeNameTree( ParseData *pd )
 {
 	for ( TermVect::Iter term = terms; term.lte(); term++ )
@@ -1735,6 +1822,7 @@ Factor::~Factor()
 			break;
 		case NfaWrap: case NfaRep:
 		case CondStar: case CondPlus:
+		case Reverse: case Match: case Capture:
 			delete expression;
 			break;
 	}
@@ -1824,7 +1912,14 @@ FsmRes Factor::walk( ParseData *pd )
 		}
 
 		return FsmAp::condPlus( exprTree.fsm, repId, action1, action2, action3, action4 );
-	}}
+	}
+	case Reverse:
+		return walkReverse( pd );
+	case Match:
+		return walkMatch( pd );
+	case Capture:
+		return walkCapture( pd );
+	}
 
 	return FsmRes( FsmRes::InternalError() );
 }
@@ -1850,6 +1945,9 @@ void Factor::makeNameTree( ParseData *pd )
 	case NfaRep:
 	case CondStar:
 	case CondPlus:
+	case Reverse:
+	case Match:
+	case Capture:
 		expression->makeNameTree( pd );
 		break;
 	}
@@ -1876,6 +1974,9 @@ void Factor::resolveNameRefs( ParseData *pd )
 	case NfaWrap:
 	case CondStar:
 	case CondPlus:
+	case Reverse:
+	case Match:
+	case Capture:
 		expression->resolveNameRefs( pd );
 		break;
 	}
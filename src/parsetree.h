@@ -344,6 +344,9 @@ struct LongestMatch
 	void resolveNameRefs( ParseData *pd );
 	void transferScannerLeavingActions( FsmAp *graph );
 	void runLongestMatch( ParseData *pd, FsmAp *graph );
+	long backtrackBound( FsmAp *graph );
+	void checkBacktrack( ParseData *pd, FsmAp *graph );
+	bool tokStartUsed( ParseData *pd );
 	Action *newLmAction( ParseData *pd, const InputLoc &loc, const char *name, 
 			InlineList *inlineList );
 	void makeActions( ParseData *pd );
@@ -479,6 +482,7 @@ struct NfaUnion
 	FsmRes walk( ParseData *pd );
 	void makeNameTree( ParseData *pd );
 	void resolveNameRefs( ParseData *pd );
+	FsmRes tuneRounds( ParseData *pd, FsmAp **machines, long numMachines );
 
 	/* Node data. */
 	TermVect terms;
@@ -660,7 +664,10 @@ struct Factor
 		NfaRep,
 		NfaWrap,
 		CondStar,
-		CondPlus
+		CondPlus,
+		Reverse,
+		Match,
+		Capture
 	}; 
 
 	enum NfaRepeatMode {
@@ -712,6 +719,9 @@ struct Factor
 
 	/* Tree traversal. */
 	FsmRes walk( ParseData *pd );
+	FsmRes walkReverse( ParseData *pd );
+	FsmRes walkMatch( ParseData *pd );
+	FsmRes walkCapture( ParseData *pd );
 	void makeNameTree( ParseData *pd );
 	void resolveNameRefs( ParseData *pd );
 
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Literal prefilter (write exec prefilter). A search machine such as
+ * any* 'GET ' ... spends most of its time in a state that loops back to
+ * itself on every character except the first of a literal. If every way out
+ * of that state is the literal itself, reading the input up to the next
+ * occurrence of the literal leaves the machine where it started. A from-state
+ * action on the search state skips there with memchr and memcmp.
+ *
+ * The states along the literal must be a plain string matcher: no actions,
+ * a mismatch returns to the search state, or to the first literal state on
+ * the first character of the literal, which may not appear again in it.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <set>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+/* Longest literal we look for. */
+#define PREFILTER_MAX_LIT 16
+
+/* No actions of any kind, plain transitions only. */
+static bool prefilterPlain( StateAp *st )
+{
+	if ( st->toStateActionTable.length() > 0 ||
+			st->fromStateActionTable.length() > 0 || st->nfaOut != 0 )
+		return false;
+
+	for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+		if ( !trans->plain() || trans->tdap()->actionTable.length() > 0 ||
+				trans->tdap()->toState == 0 )
+			return false;
+	}
+	return true;
+}
+
+/* The single key on which the state goes somewhere other than back to the
+ * search state (or to the first literal state on the first key). Returns false
+ * if there is not exactly one such key. Gaps go to the error state, so they
+ * are exits as well. */
+static bool prefilterNext( KeyOps *keyOps, StateAp *st, StateAp *search,
+		StateAp *first, Key firstKey, Key &key, StateAp *&target )
+{
+	unsigned long long covered = 0;
+	bool found = false;
+
+	for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+		StateAp *to = trans->tdap()->toState;
+		covered += keyOps->span( trans->lowKey, trans->highKey );
+
+		if ( to == search )
+			continue;
+
+		if ( first != 0 && to == first && keyOps->eq( trans->lowKey, firstKey ) &&
+				keyOps->eq( trans->highKey, firstKey ) )
+			continue;
+
+		if ( found || !keyOps->eq( trans->lowKey, trans->highKey ) )
+			return false;
+
+		found = true;
+		key = trans->lowKey;
+		target = to;
+	}
+
+	return found && covered == keyOps->span( keyOps->minKey, keyOps->maxKey );
+}
+
+/* Find the literal that leads out of a search state. */
+static void prefilterLiteral( KeyOps *keyOps, StateAp *search, std::vector<Key> &lit )
+{
+	if ( !prefilterPlain( search ) )
+		return;
+
+	Key none = keyOps->minKey, firstKey = keyOps->minKey;
+	StateAp *first = 0;
+	if ( !prefilterNext( keyOps, search, search, 0, none, firstKey, first ) )
+		return;
+
+	lit.push_back( firstKey );
+
+	std::set<StateAp*> chain;
+	chain.insert( search );
+	chain.insert( first );
+
+	StateAp *st = first;
+	while ( lit.size() < PREFILTER_MAX_LIT ) {
+		Key key = keyOps->minKey;
+		StateAp *next = 0;
+		if ( !prefilterPlain( st ) ||
+				!prefilterNext( keyOps, st, search, first, firstKey, key, next ) ||
+				keyOps->eq( key, firstKey ) || chain.find( next ) != chain.end() )
+			break;
+
+		lit.push_back( key );
+		chain.insert( next );
+		st = next;
+	}
+}
+
+/* Called after the graph is built, before analysis and reduction. */
+void ParseData::makePrefilter( FsmAp *graph, const HostLang *hostLang )
+{
+	const InputLoc &loc = prefilterWrite->loc;
+	KeyOps *keyOps = fsmCtx->keyOps;
+
+	if ( hostLang != &hostLangC ) {
+		id->error( loc ) << "write exec prefilter is only supported "
+				"by the C host language" << endl;
+		return;
+	}
+
+	if ( fsmCtx->pExpr != 0 || fsmCtx->peExpr != 0 || fsmCtx->getKeyExpr != 0 ) {
+		id->error( loc ) << "write exec prefilter requires the default "
+				"p and pe variables and no getkey" << endl;
+		return;
+	}
+
+	if ( keyOps->span( keyOps->minKey, keyOps->maxKey ) > 0x100 ) {
+		id->error( loc ) << "write exec prefilter requires a "
+				"single byte alphabet type" << endl;
+		return;
+	}
+
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		std::vector<Key> lit;
+		prefilterLiteral( keyOps, st, lit );
+		if ( lit.size() == 0 )
+			continue;
+
+		long litId = -1;
+		for ( size_t l = 0; l < prefilterLits.size() && litId < 0; l++ ) {
+			bool same = prefilterLits[l].size() == lit.size();
+			for ( size_t k = 0; same && k < lit.size(); k++ )
+				same = keyOps->eq( prefilterLits[l][k], lit[k] );
+			if ( same )
+				litId = l;
+		}
+		if ( litId < 0 ) {
+			litId = prefilterLits.size();
+			prefilterLits.push_back( lit );
+		}
+
+		std::stringstream body;
+		body << "{ p = " << sectionName << "_skip_" << litId << "( p, pe ); }";
+
+		InlineList *il = new InlineList;
+		il->append( new InlineItem( loc, body.str(), InlineItem::Text ) );
+
+		Action *action = new Action( loc, "prefilter", il, fsmCtx->nextCondId++ );
+		action->embedRoots.append( rootName );
+		fsmCtx->actionList.append( action );
+
+		st->fromStateActionTable.setAction( fsmCtx->curActionOrd++, action );
+		prefilterStates += 1;
+	}
+
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-prefilter-states\t" << prefilterStates << endl;
+		for ( size_t l = 0; l < prefilterLits.size(); l++ )
+			id->stats() << "fsm-prefilter-literal\t" << prefilterLits[l].size() << endl;
+	}
+}
+
+/* One skip function per literal. Returns the next position the literal could
+ * start at. It never returns pe, and leaves a partial literal at the end of
+ * the buffer to the machine, so the state is correct if exec is called again
+ * with more input. */
+void ParseData::writePrefilterData( std::ostream &out )
+{
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+
+	for ( size_t l = 0; l < prefilterLits.size(); l++ ) {
+		std::vector<Key> &lit = prefilterLits[l];
+		long keep = lit.size() > 1 ? lit.size() - 1 : 1;
+
+		out << "static " << alph << " " << sectionName << "_lit_" << l << "[] = { ";
+		for ( size_t k = 0; k < lit.size(); k++ )
+			out << lit[k].getVal() << ", ";
+		out << "};\n"
+			"\n"
+			"static " << alph << " *" << sectionName << "_skip_" << l <<
+					"( " << alph << " *p, " << alph << " *pe )\n"
+			"{\n"
+			"	" << alph << " *q;\n"
+			"	while ( pe - p >= " << lit.size() << " ) {\n"
+			"		q = (" << alph << "*) memchr( p, (unsigned char)" <<
+					sectionName << "_lit_" << l << "[0], ( pe - p ) - " <<
+					( lit.size() - 1 ) << " );\n"
+			"		if ( q == 0 )\n"
+			"			return pe - " << keep << ";\n"
+			"		if ( memcmp( q + 1, " << sectionName << "_lit_" << l << " + 1, " <<
+					( lit.size() - 1 ) << " ) == 0 )\n"
+			"			return q;\n"
+			"		p = q + 1;\n"
+			"	}\n"
+			"	return p;\n"
+			"}\n"
+			"\n";
+	}
+}
@@ -0,0 +1,388 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Reversed machines. :reverse( expr ): accepts exactly the strings of expr
+ * written backwards. It is built by a subset construction over the incoming
+ * transitions of the machine, starting from the set of its final states, so
+ * the result is already deterministic. It is minimized before being returned.
+ *
+ * write exec_reverse emits a function that runs a reversed machine from a
+ * position down to a lower bound. Given the end of a match found by a forward
+ * machine it finds the start of the match in time proportional to its length.
+ */
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+/* Largest alphabet the class map is generated for. */
+#define REVERSE_MAX_SPAN 0x10000
+
+/* A transition of the original machine, as a half open range of key offsets. */
+struct RevEdge
+{
+	unsigned long long low, high;
+	long from;
+};
+
+typedef std::vector<long> RevSet;
+
+static Key reverseKey( KeyOps *keyOps, unsigned long long offset )
+{
+	return Key( (long)( keyOps->minKey.getVal() + offset ) );
+}
+
+/* Only the language can be reversed. Actions and conditions have no meaning
+ * when the input is read the other way. */
+static bool reversePlain( ParseData *pd, const InputLoc &loc, FsmAp *fsm )
+{
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		if ( st->nfaOut != 0 ) {
+			pd->id->error( loc ) << "reverse operator cannot be applied "
+					"to a machine with NFA transitions" << endl;
+			return false;
+		}
+
+		bool actions = st->toStateActionTable.length() > 0 ||
+				st->fromStateActionTable.length() > 0 ||
+				st->eofActionTable.length() > 0 ||
+				st->outActionTable.length() > 0;
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( !trans->plain() ) {
+				pd->id->error( loc ) << "reverse operator cannot be applied "
+						"to a machine with conditions" << endl;
+				return false;
+			}
+			if ( trans->tdap()->actionTable.length() > 0 )
+				actions = true;
+		}
+
+		if ( actions ) {
+			pd->id->error( loc ) << "reverse operator cannot be applied "
+					"to a machine with actions" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+FsmRes Factor::walkReverse( ParseData *pd )
+{
+	FsmRes exprTree = expression->walk( pd );
+	if ( !exprTree.success() )
+		return exprTree;
+
+	FsmAp *fsm = exprTree.fsm;
+	if ( !reversePlain( pd, loc, fsm ) ) {
+		delete fsm;
+		return FsmRes( FsmRes::InternalError() );
+	}
+
+	KeyOps *keyOps = pd->fsmCtx->keyOps;
+
+	std::map<StateAp*, long> index;
+	std::vector<StateAp*> states;
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		index[st] = states.size();
+		states.push_back( st );
+	}
+
+	/* Incoming transitions of each state. */
+	std::vector< std::vector<RevEdge> > incoming( states.size() );
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			StateAp *to = trans->tdap()->toState;
+			if ( to == 0 )
+				continue;
+
+			RevEdge edge;
+			edge.low = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+			edge.high = edge.low + keyOps->span( trans->lowKey, trans->highKey );
+			edge.from = index[st];
+			incoming[index[to]].push_back( edge );
+		}
+	}
+
+	long origStart = index[fsm->startState];
+	FsmAp *rev = FsmAp::emptyFsm( pd->fsmCtx );
+
+	std::map<RevSet, StateAp*> dstates;
+	std::vector<RevSet> queue;
+
+	RevSet start;
+	for ( size_t s = 0; s < states.size(); s++ ) {
+		if ( states[s]->isFinState() )
+			start.push_back( s );
+	}
+	dstates[start] = rev->startState;
+	queue.push_back( start );
+	if ( std::binary_search( start.begin(), start.end(), origStart ) )
+		rev->setFinState( rev->startState );
+
+	for ( size_t q = 0; q < queue.size(); q++ ) {
+		RevSet set = queue[q];
+		StateAp *from = dstates[set];
+
+		std::vector<RevEdge> edges;
+		std::vector<unsigned long long> bounds;
+		for ( size_t s = 0; s < set.size(); s++ ) {
+			std::vector<RevEdge> &in = incoming[set[s]];
+			for ( size_t e = 0; e < in.size(); e++ ) {
+				edges.push_back( in[e] );
+				bounds.push_back( in[e].low );
+				bounds.push_back( in[e].high );
+			}
+		}
+		std::sort( bounds.begin(), bounds.end() );
+		bounds.erase( std::unique( bounds.begin(), bounds.end() ), bounds.end() );
+
+		/* Runs of keys going to the same set become one transition. */
+		StateAp *pendTarg = 0;
+		unsigned long long pendLow = 0, pendHigh = 0;
+		for ( size_t b = 0; b + 1 < bounds.size(); b++ ) {
+			RevSet preds;
+			for ( size_t e = 0; e < edges.size(); e++ ) {
+				if ( edges[e].low <= bounds[b] && bounds[b] < edges[e].high )
+					preds.push_back( edges[e].from );
+			}
+			std::sort( preds.begin(), preds.end() );
+			preds.erase( std::unique( preds.begin(), preds.end() ), preds.end() );
+
+			StateAp *targ = 0;
+			if ( preds.size() > 0 ) {
+				std::map<RevSet, StateAp*>::iterator d = dstates.find( preds );
+				if ( d != dstates.end() )
+					targ = d->second;
+				else {
+					targ = rev->addState();
+					if ( std::binary_search( preds.begin(), preds.end(), origStart ) )
+						rev->setFinState( targ );
+					dstates[preds] = targ;
+					queue.push_back( preds );
+				}
+			}
+
+			if ( pendTarg != 0 && ( targ != pendTarg || bounds[b] != pendHigh ) ) {
+				rev->attachNewTrans( from, pendTarg, reverseKey( keyOps, pendLow ),
+						reverseKey( keyOps, pendHigh - 1 ) );
+				pendTarg = 0;
+			}
+
+			if ( targ != 0 ) {
+				if ( pendTarg == 0 ) {
+					pendTarg = targ;
+					pendLow = bounds[b];
+				}
+				pendHigh = bounds[b + 1];
+			}
+		}
+
+		if ( pendTarg != 0 ) {
+			rev->attachNewTrans( from, pendTarg, reverseKey( keyOps, pendLow ),
+					reverseKey( keyOps, pendHigh - 1 ) );
+		}
+
+		if ( pd->fsmCtx->stateLimit != FsmCtx::STATE_UNLIMITED &&
+				rev->stateList.length() > pd->fsmCtx->stateLimit )
+		{
+			delete rev;
+			delete fsm;
+			return FsmRes( FsmRes::TooManyStates() );
+		}
+	}
+
+	delete fsm;
+
+	rev->minimizePartition2();
+	rev->verifyIntegrity();
+
+	if ( pd->id->printStatistics )
+		pd->id->stats() << "fsm-reverse-states\t" << rev->stateList.length() << endl;
+
+	return FsmRes( FsmRes::Fsm(), rev );
+}
+
+bool ParseData::reverseCheck( const InputLoc &loc )
+{
+	if ( fsmCtx->getKeyExpr != 0 ) {
+		id->error( loc ) << "write exec_reverse cannot be used with getkey" << endl;
+		return false;
+	}
+
+	KeyOps *keyOps = fsmCtx->keyOps;
+	if ( keyOps->span( keyOps->minKey, keyOps->maxKey ) > REVERSE_MAX_SPAN ) {
+		id->error( loc ) << "write exec_reverse: alphabet type is too wide" << endl;
+		return false;
+	}
+
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		bool actions = st->nfaOut != 0 ||
+				st->toStateActionTable.length() > 0 ||
+				st->fromStateActionTable.length() > 0 ||
+				st->eofActionTable.length() > 0;
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( !trans->plain() || trans->tdap()->actionTable.length() > 0 )
+				actions = true;
+		}
+
+		if ( actions ) {
+			id->error( loc ) << "write exec_reverse requires a machine without "
+					"actions, conditions or NFA transitions" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ParseData::writeExecReverse( std::ostream &out, const InputLoc &loc )
+{
+	if ( !reverseCheck( loc ) )
+		return;
+
+	KeyOps *keyOps = fsmCtx->keyOps;
+	long numStates = sectionGraph->stateList.length();
+	unsigned long long alphSpan = keyOps->span( keyOps->minKey, keyOps->maxKey );
+
+	/* State zero is the start state, -1 is the error state. */
+	std::map<StateAp*, long> index;
+	index[sectionGraph->startState] = 0;
+	long i = 1;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		if ( st != sectionGraph->startState )
+			index[st] = i++;
+	}
+
+	/* Class boundaries are wherever any state's target may change. Identical
+	 * columns of targets share a class. */
+	std::vector<bool> boundary( alphSpan + 1, false );
+	boundary[0] = true;
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			unsigned long long low = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+			boundary[low] = true;
+			boundary[low + keyOps->span( trans->lowKey, trans->highKey )] = true;
+		}
+	}
+
+	std::vector<long> keyClass( alphSpan );
+	std::vector< std::vector<long> > columns;
+	std::map< std::vector<long>, long > columnIds;
+	long curClass = 0;
+	for ( unsigned long long k = 0; k < alphSpan; k++ ) {
+		if ( boundary[k] ) {
+			std::vector<long> column( numStates, -1 );
+			for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ ) {
+				for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+					unsigned long long low = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+					unsigned long long high = low + keyOps->span( trans->lowKey, trans->highKey );
+					if ( low <= k && k < high && trans->tdap()->toState != 0 ) {
+						column[index[st]] = index[trans->tdap()->toState];
+						break;
+					}
+				}
+			}
+
+			std::map< std::vector<long>, long >::iterator c = columnIds.find( column );
+			if ( c == columnIds.end() ) {
+				curClass = columnIds[column] = columns.size();
+				columns.push_back( column );
+			}
+			else {
+				curClass = c->second;
+			}
+		}
+		keyClass[k] = curClass;
+	}
+
+	long classBytes = columns.size() <= 0x100 ? 1 : 2;
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-reverse-classes\t" << columns.size() << endl;
+		id->stats() << "fsm-reverse-bytes\t" << ( alphSpan * classBytes +
+				columns.size() * numStates * 4 + numStates ) << endl;
+	}
+
+	std::string name = sectionName;
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+
+	out <<
+		"static const unsigned " << ( classBytes == 1 ? "char" : "short" ) <<
+				" " << name << "_reverse_class[] = {\n\t";
+	for ( unsigned long long k = 0; k < alphSpan; k++ ) {
+		out << keyClass[k] << ", ";
+		if ( k % 16 == 15 )
+			out << "\n\t";
+	}
+	out << "\n};\n"
+		"\n"
+		"static const int " << name << "_reverse_trans[][" << numStates << "] = {\n";
+	for ( size_t c = 0; c < columns.size(); c++ ) {
+		out << "\t{ ";
+		for ( long s = 0; s < numStates; s++ )
+			out << columns[c][s] << ", ";
+		out << "},\n";
+	}
+	out << "};\n"
+		"\n"
+		"static const char " << name << "_reverse_final[] = { ";
+	std::vector<int> final( numStates, 0 );
+	for ( StateList::Iter st = sectionGraph->stateList; st.lte(); st++ )
+		final[index[st]] = st->isFinState() ? 1 : 0;
+	for ( long s = 0; s < numStates; s++ )
+		out << final[s] << ", ";
+	out << "};\n"
+		"\n"
+		"/* Steps back from p, not below lower. Returns the lowest position at which\n"
+		" * the machine was in a final state, or null if it never was. */\n"
+		"static " << alph << " *" << name << "_reverse( " << alph << " *lower, " <<
+				alph << " *p )\n"
+		"{\n"
+		"	" << alph << " *found = 0;\n"
+		"	int s = 0;\n"
+		"\n"
+		"	if ( " << name << "_reverse_final[s] )\n"
+		"		found = p;\n"
+		"	while ( p > lower ) {\n"
+		"		p -= 1;\n"
+		"		s = " << name << "_reverse_trans[" << name << "_reverse_class[(long)*p - (" <<
+				keyOps->minKey.getVal() << "L)]][s];\n"
+		"		if ( s < 0 )\n"
+		"			break;\n"
+		"		if ( " << name << "_reverse_final[s] )\n"
+		"			found = p;\n"
+		"	}\n"
+		"	return found;\n"
+		"}\n";
+}
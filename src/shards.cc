@@ -0,0 +1,210 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Table shards (--table-shards=N). The arrays written by write data are moved
+ * into N extra C files, named after the output file, and replaced with extern
+ * declarations. Each array goes to the shard picked by a hash of its name, so
+ * a change to one array does not move the others. The shards are collected in
+ * memory and a shard file is only replaced when its text changes, so builds
+ * can skip the unchanged ones. The arrays are no longer static, so their
+ * names are prefixed with the output file's name, and the output defines the
+ * original names as macros for the prefixed ones.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <libfsm/ragel.h>
+#include "inputdata.h"
+
+using std::endl;
+
+/* The output file name with its suffix replaced. */
+std::string InputData::outputFileWith( const std::string &suffix )
+{
+	const char *fn = fileNameFromStem( outputFileName, suffix.c_str() );
+	std::string name = fn;
+	delete[] fn;
+	return name;
+}
+
+/* The name of shard n: foo.c becomes foo-tab<n>.c. */
+static std::string shardFileName( InputData *id, long n )
+{
+	const char *ext = findFileExtension( id->outputFileName );
+
+	std::stringstream suffix;
+	suffix << "-tab" << n << ( ext != 0 ? ext : "" );
+	return id->outputFileWith( suffix.str() );
+}
+
+/* An identifier made from the output file name without its directory and
+ * suffix, for names that must differ between outputs linked together. */
+std::string InputData::outputSymbol()
+{
+	std::string name = outputFileWith( "" );
+	std::string::size_type slash = name.rfind( '/' );
+	std::string::size_type start = slash == std::string::npos ? 0 : slash + 1;
+
+	std::string sym;
+	for ( std::string::size_type i = start; i < name.size(); i++ ) {
+		char c = name[i];
+		bool ident = ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) ||
+				( c >= '0' && c <= '9' ) || c == '_';
+		sym += ident ? c : '_';
+	}
+	return sym;
+}
+
+/* If the line starts an array definition, read the rest of it from the input
+ * and split it up. Otherwise returns false and reads nothing. */
+bool readTableArray( std::istream &in, const std::string &line, TableArray &array )
+{
+	std::string::size_type init = line.find( "[] = {" );
+	if ( line.compare( 0, 13, "static const " ) != 0 || init == std::string::npos )
+		return false;
+
+	/* Split "<type> <name>" at the last space. */
+	std::string decl = line.substr( 13, init - 13 );
+	std::string::size_type sp = decl.rfind( ' ' );
+	if ( sp == std::string::npos )
+		return false;
+
+	array.type = decl.substr( 0, sp );
+	while ( array.type.size() > 0 && array.type[array.type.size() - 1] == ' ' )
+		array.type.erase( array.type.size() - 1 );
+	array.name = decl.substr( sp + 1 );
+
+	array.init = line.substr( init + 3 ) + '\n';
+	std::string next = line;
+	while ( next.find( "};" ) == std::string::npos && std::getline( in, next ) )
+		array.init += next + '\n';
+	return true;
+}
+
+/* FNV-1a. The same on every host, so the shard of an array depends only on
+ * its name. */
+static unsigned long shardHash( const std::string &name )
+{
+	unsigned long h = 2166136261UL;
+	for ( std::string::size_type i = 0; i < name.size(); i++ ) {
+		h ^= (unsigned char)name[i];
+		h = ( h * 16777619UL ) & 0xffffffffUL;
+	}
+	return h;
+}
+
+/* True if the file exists and holds exactly the text. */
+static bool shardUnchanged( const std::string &fn, const std::string &text )
+{
+	std::ifstream in( fn.c_str(), std::ios::in | std::ios::binary );
+	if ( !in.is_open() )
+		return false;
+
+	std::stringstream old;
+	old << in.rdbuf();
+	return old.str() == text;
+}
+
+void InputData::shardTables( const std::string &data )
+{
+	if ( shardStreams.size() == 0 ) {
+		if ( outputFileName == 0 )
+			error() << "--table-shards requires an output file" << endp;
+
+		for ( long n = 0; n < tableShards; n++ ) {
+			std::ostringstream *shard = new std::ostringstream;
+			*shard << "/* Table data for " << outputFileName << ". */\n\n";
+			shardStreams.push_back( shard );
+			shardBytes.push_back( 0 );
+		}
+	}
+
+	std::istringstream in( data );
+	std::string line;
+	while ( std::getline( in, line ) ) {
+		TableArray array;
+		if ( !readTableArray( in, line, array ) ) {
+			*outStream << line << '\n';
+			continue;
+		}
+
+		std::string global = "_rls_" + outputSymbol() + "_" + array.name;
+		std::string decl = "const " + array.type + " " + global + "[]";
+		std::string def = decl + " " + array.init;
+
+		size_t s = shardHash( array.name ) % shardStreams.size();
+
+		/* The declaration first gives the definition external linkage in C++. */
+		*shardStreams[s] << "extern " << decl << ";\n" << def << '\n';
+		shardBytes[s] += def.size();
+
+		*outStream << "#define " << array.name << " " << global << "\n"
+				"extern " << decl << ";\n";
+	}
+}
+
+void InputData::closeShards()
+{
+	if ( printStatistics ) {
+		for ( size_t s = 0; s < shardStreams.size(); s++ )
+			stats() << "table-shard\t" << s << "\t" << shardBytes[s] << endl;
+	}
+
+	/* Replace a shard only if it changed, by renaming a complete file over
+	 * it. Nothing is written for a failed run. */
+	for ( size_t s = 0; s < shardStreams.size() && errorCount == 0; s++ ) {
+		std::string fn = shardFileName( this, s );
+		std::string text = shardStreams[s]->str();
+		if ( shardUnchanged( fn, text ) )
+			continue;
+
+		std::string tmp = fn + ".tmp";
+		std::ofstream out( tmp.c_str(), std::ios::out | std::ios::trunc | std::ios::binary );
+		if ( !out.is_open() )
+			error() << "error opening " << tmp << " for writing" << endp;
+		out << text;
+		out.close();
+		if ( out.fail() || rename( tmp.c_str(), fn.c_str() ) != 0 ) {
+			unlink( tmp.c_str() );
+			error() << "error writing " << fn << endp;
+		}
+	}
+
+	/* Shards left by an earlier run with a larger N. */
+	if ( shardStreams.size() > 0 && errorCount == 0 ) {
+		for ( long n = shardStreams.size(); ; n++ ) {
+			std::string fn = shardFileName( this, n );
+			if ( unlink( fn.c_str() ) != 0 )
+				break;
+		}
+	}
+
+	for ( size_t s = 0; s < shardStreams.size(); s++ )
+		delete shardStreams[s];
+	shardStreams.clear();
+	shardBytes.clear();
+}
@@ -0,0 +1,523 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Shared action bodies (--share-actions). Files with many sections tend to
+ * define the same small actions in each of them. A named action whose body is
+ * plain code, fpc and fc is looked up by its text in a table kept for the
+ * whole output file. A body that more than one named action has is shared:
+ * the first section to use one defines it as a static function with its write
+ * data, and every action with that body becomes a call, passing p.
+ *
+ * Sections are generated at their last reference, not in file order, so the
+ * position of the write statements decides what a section may do. It only
+ * defines functions if its first write data is at file scope, judged by the
+ * braces of the host code before it, and comes before its other writes. It
+ * only calls a function whose definition comes before all of its writes other
+ * than data. Anything else keeps its body.
+ *
+ * The function only sees p and names visible at file scope. Bodies that name
+ * ragel's variables, or names that look declared in the host code of the
+ * function around a write exec, are left alone, as are bodies that return,
+ * jump, break, continue or assign p and everything in sections with a getkey
+ * expression. Locals declared in ways the scan does not recognize still fail
+ * to compile or, if a file scope name is shadowed, quietly refer to it.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <set>
+#include <vector>
+#include <ctype.h>
+#include <string.h>
+
+#include <libfsm/ragel.h>
+#include "parsedata.h"
+#include "parsetree.h"
+#include "inputdata.h"
+
+using std::endl;
+
+/* The variables of the exec code. */
+static const char *shareExecNames[] = {
+	"cs", "pe", "eof", "top", "stack", "act", "ts", "te",
+	"nbreak", "nfa_bp", "nfa_len", "nfa_count", 0
+};
+
+/* The body as it will appear in the function, or false if it contains
+ * anything other than plain code, fpc and fc. */
+static bool shareBody( InlineList *inlineList, std::string &body )
+{
+	for ( InlineList::Iter item = *inlineList; item.lte(); item++ ) {
+		switch ( item->type ) {
+			case InlineItem::Text:
+				body += item->data;
+				break;
+			case InlineItem::PChar:
+				body += "p";
+				break;
+			case InlineItem::Char:
+				body += "(*p)";
+				break;
+			default:
+				return false;
+		}
+
+		if ( item->children != 0 && !shareBody( item->children, body ) )
+			return false;
+	}
+	return true;
+}
+
+/* Moves past the string or character literal or comment at i, if there is
+ * one there. */
+static bool shareSkip( const std::string &text, std::string::size_type &i )
+{
+	std::string::size_type n = text.size();
+	char c = text[i];
+	if ( c == '"' || c == '\'' ) {
+		i += 1;
+		while ( i < n && text[i] != c )
+			i += text[i] == '\\' ? 2 : 1;
+		i += 1;
+	}
+	else if ( text.compare( i, 2, "//" ) == 0 ) {
+		i = text.find( '\n', i );
+		if ( i == std::string::npos )
+			i = n;
+	}
+	else if ( text.compare( i, 2, "/*" ) == 0 ) {
+		i = text.find( "*/", i + 2 );
+		i = i == std::string::npos ? n : i + 2;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+/* The position of the last non-space character before pos, or npos. */
+static std::string::size_type sharePrev( const std::string &body,
+		std::string::size_type pos )
+{
+	while ( pos > 0 ) {
+		pos -= 1;
+		if ( !isspace( body[pos] ) )
+			return pos;
+	}
+	return std::string::npos;
+}
+
+/* The position of the first non-space character at or after pos. */
+static std::string::size_type shareNext( const std::string &body,
+		std::string::size_type pos )
+{
+	while ( pos < body.size() && isspace( body[pos] ) )
+		pos += 1;
+	return pos;
+}
+
+static bool shareIdentChar( char c )
+{
+	return isalnum( c ) || c == '_';
+}
+
+/* True if the word starting at pos follows . or ->, making it a member. */
+static bool shareMember( const std::string &body, std::string::size_type pos )
+{
+	std::string::size_type b = sharePrev( body, pos );
+	return b != std::string::npos && ( body[b] == '.' ||
+			( body[b] == '>' && b > 0 && body[b-1] == '-' ) );
+}
+
+typedef std::vector< std::pair<std::string::size_type,
+		std::string::size_type> > ShareWords;
+
+/* The start and end of each identifier of the text that is not a member,
+ * skipping literals and comments. */
+static void shareWords( const std::string &text, ShareWords &words )
+{
+	std::string::size_type i = 0, n = text.size();
+	while ( i < n ) {
+		if ( shareSkip( text, i ) )
+			continue;
+
+		if ( isalpha( text[i] ) || text[i] == '_' ) {
+			std::string::size_type start = i;
+			while ( i < n && shareIdentChar( text[i] ) )
+				i += 1;
+
+			if ( !shareMember( text, start ) )
+				words.push_back( std::make_pair( start, i ) );
+		}
+		else {
+			i += 1;
+		}
+	}
+}
+
+/* False if the body leaves the action with return, goto, break or continue,
+ * or changes p. Neither does the same thing in a function. */
+static bool shareSafe( const std::string &body, const ShareWords &words )
+{
+	std::string::size_type n = body.size();
+	for ( size_t w = 0; w < words.size(); w++ ) {
+		std::string::size_type start = words[w].first, i = words[w].second;
+		std::string word = body.substr( start, i - start );
+		if ( word == "return" || word == "goto" ||
+				word == "break" || word == "continue" )
+			return false;
+
+		if ( word == "p" ) {
+			/* ++p, --p */
+			std::string::size_type b = sharePrev( body, start );
+			std::string::size_type b2 = b != std::string::npos ?
+					sharePrev( body, b ) : std::string::npos;
+			if ( b2 != std::string::npos && body[b] == body[b2] &&
+					( body[b] == '+' || body[b] == '-' ) )
+				return false;
+
+			/* p = , p++, p--, p += and so on. */
+			std::string::size_type a = shareNext( body, i );
+			if ( a < n && body[a] == '=' && ( a + 1 == n || body[a+1] != '=' ) )
+				return false;
+			if ( a + 1 < n && ( body[a] == '+' || body[a] == '-' ) &&
+					( body[a+1] == body[a] || body[a+1] == '=' ) )
+				return false;
+		}
+	}
+	return true;
+}
+
+/* False if the body names something only the exec code can see: one of
+ * ragel's variables or one of the locals. The function gets its own p. */
+static bool shareVisible( const std::string &body, const ShareWords &words,
+		const std::set<std::string> &locals )
+{
+	for ( size_t w = 0; w < words.size(); w++ ) {
+		std::string word = body.substr( words[w].first,
+				words[w].second - words[w].first );
+		if ( word == "p" )
+			continue;
+
+		for ( const char **name = shareExecNames; *name != 0; name++ ) {
+			if ( word == *name )
+				return false;
+		}
+		if ( locals.find( word ) != locals.end() )
+			return false;
+	}
+	return true;
+}
+
+/* Collects the names the text appears to declare: a name after a type, a *
+ * or a comma, and before =, ;, ,, [ or ). Some expressions match too, which
+ * only means fewer bodies are shared. */
+static void shareDeclared( const std::string &text, std::set<std::string> &names )
+{
+	ShareWords words;
+	shareWords( text, words );
+
+	for ( size_t w = 0; w < words.size(); w++ ) {
+		std::string::size_type start = words[w].first, i = words[w].second;
+
+		std::string::size_type a = shareNext( text, i );
+		if ( a == text.size() || text[a] == 0 ||
+				strchr( "=;,[)", text[a] ) == 0 ||
+				text.compare( a, 2, "==" ) == 0 )
+			continue;
+
+		std::string::size_type b = sharePrev( text, start );
+		if ( b == std::string::npos )
+			continue;
+
+		bool declared = text[b] == '*' || text[b] == ',';
+		if ( shareIdentChar( text[b] ) ) {
+			std::string::size_type end = b + 1;
+			while ( b > 0 && shareIdentChar( text[b-1] ) )
+				b -= 1;
+			std::string prev = text.substr( b, end - b );
+			declared = prev != "return" && prev != "goto" && prev != "case" &&
+					prev != "sizeof" && prev != "else" && prev != "do";
+		}
+
+		if ( declared )
+			names.insert( text.substr( start, i - start ) );
+	}
+}
+
+/* Braces opened and not closed by the text, skipping comments and literals. */
+static long shareDepth( const std::string &text )
+{
+	long depth = 0;
+	std::string::size_type i = 0, n = text.size();
+	while ( i < n ) {
+		if ( shareSkip( text, i ) )
+			continue;
+
+		if ( text[i] == '{' )
+			depth += 1;
+		else if ( text[i] == '}' )
+			depth -= 1;
+		i += 1;
+	}
+	return depth;
+}
+
+/* The names declared in the host code of the functions around the section's
+ * writes other than data, from the end of the last top level declaration or
+ * definition before each of them. */
+static void shareLocals( InputData *id, ParseData *pd, std::set<std::string> &locals )
+{
+	std::string text;
+	long depth = 0;
+	for ( InputItemList::Iter ii = id->inputItems; ii.lte(); ii++ ) {
+		if ( ii->type == InputItem::HostData ) {
+			std::string data = ii->data.str();
+			std::string::size_type i = 0, start = 0, n = data.size();
+			while ( i < n ) {
+				if ( shareSkip( data, i ) )
+					continue;
+
+				char c = data[i++];
+				if ( c == '{' )
+					depth += 1;
+				else if ( c == '}' )
+					depth -= 1;
+
+				if ( depth == 0 && ( c == ';' || c == '}' ) ) {
+					text.clear();
+					start = i;
+				}
+			}
+			text += data.substr( start < n ? start : n );
+		}
+		else if ( ii->type == InputItem::Write && ii->pd == pd &&
+				ii->writeArgs.size() > 0 && ii->writeArgs[0] != "data" ) {
+			shareDeclared( text, locals );
+		}
+	}
+}
+
+/* The parameter type of the functions made for the section. */
+static std::string shareParamType( ParseData *pd, const HostLang *hostLang )
+{
+	HostType *alphType = pd->alphTypeSet ? pd->userAlphType :
+			&hostLang->hostTypes[hostLang->defaultAlphType];
+
+	std::string alph = std::string( "const " ) + alphType->data1;
+	if ( alphType->data2 != 0 )
+		alph += std::string( " " ) + alphType->data2;
+	return alph;
+}
+
+/* The key of the action's body in the tables of the output, or false if it
+ * cannot be shared. Named actions only, generated ones refer to the machine. */
+static bool shareKey( ParseData *pd, Action *act, const std::string &alph,
+		const std::set<std::string> &locals, std::string &key )
+{
+	if ( act->name.empty() || pd->actionDict.find( act->name ) != act ||
+			act->paramList != 0 || act->inlineList == 0 )
+		return false;
+
+	std::string body;
+	if ( !shareBody( act->inlineList, body ) )
+		return false;
+
+	ShareWords words;
+	shareWords( body, words );
+	if ( !shareSafe( body, words ) || !shareVisible( body, words, locals ) )
+		return false;
+
+	/* The parameter type is part of the key. */
+	key = alph + '\n' + body;
+	return true;
+}
+
+/* Count the bodies of every section parsed so far, before any of them are
+ * replaced by calls. Actions a section ends up not using are counted too. */
+static void shareCount( InputData *id, const HostLang *hostLang )
+{
+	for ( ParseDataList::Iter pd = id->parseDataList; pd.lte(); pd++ ) {
+		if ( pd->fsmCtx->getKeyExpr != 0 )
+			continue;
+
+		std::string alph = shareParamType( pd, hostLang );
+		std::set<std::string> locals;
+		shareLocals( id, pd, locals );
+
+		for ( ActionList::Iter act = pd->fsmCtx->actionList; act.lte(); act++ ) {
+			std::string key;
+			if ( shareKey( pd, act, alph, locals, key ) )
+				id->sharedCounts[key] += 1;
+		}
+	}
+	id->sharedCounted = true;
+}
+
+/* Finds, by position in the input items, the section's first write data and
+ * its first other write, or -1. Returns true if the data is outside any braces
+ * of the host code, so functions can be defined there. */
+static bool sharePlace( InputData *id, ParseData *pd, long &data, long &use )
+{
+	bool fileScope = false;
+	long depth = 0, pos = 0;
+	data = use = -1;
+	for ( InputItemList::Iter ii = id->inputItems; ii.lte(); ii++, pos++ ) {
+		if ( ii->type == InputItem::HostData )
+			depth += shareDepth( ii->data.str() );
+		else if ( ii->type == InputItem::Write && ii->pd == pd &&
+				ii->writeArgs.size() > 0 ) {
+			if ( ii->writeArgs[0] != "data" ) {
+				if ( use < 0 )
+					use = pos;
+			}
+			else if ( data < 0 ) {
+				data = pos;
+				fileScope = depth == 0;
+			}
+		}
+	}
+	return fileScope;
+}
+
+static void shareUsed( std::set<Action*> &used, ActionTable &table )
+{
+	for ( ActionTable::Iter ati = table; ati.lte(); ati++ )
+		used.insert( ati->value );
+}
+
+static void shareConds( std::set<Action*> &conds, CondSpace *condSpace )
+{
+	if ( condSpace != 0 ) {
+		for ( CondSet::Iter csi = condSpace->condSet; csi.lte(); csi++ )
+			conds.insert( *csi );
+	}
+}
+
+/* Called after the graph is built, before analysis and reduction. */
+void ParseData::makeSharedActions( FsmAp *graph, const HostLang *hostLang )
+{
+	/* With getkey fc is not *p. */
+	if ( hostLang != &hostLangC || fsmCtx->getKeyExpr != 0 )
+		return;
+
+	if ( !id->sharedCounted )
+		shareCount( id, hostLang );
+
+	/* Actions run as statements, and those tested as conditions, which must
+	 * stay expressions. */
+	std::set<Action*> used, conds;
+	for ( StateList::Iter st = graph->stateList; st.lte(); st++ ) {
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( trans->plain() )
+				shareUsed( used, trans->tdap()->actionTable );
+			else {
+				shareConds( conds, trans->tcap()->condSpace );
+				for ( CondList::Iter cond = trans->tcap()->condList; cond.lte(); cond++ )
+					shareUsed( used, cond->actionTable );
+			}
+		}
+
+		shareUsed( used, st->toStateActionTable );
+		shareUsed( used, st->fromStateActionTable );
+		shareUsed( used, st->eofActionTable );
+		shareConds( conds, st->outCondSpace );
+
+		if ( st->nfaOut != 0 ) {
+			for ( NfaTransList::Iter nt = *st->nfaOut; nt.lte(); nt++ ) {
+				shareUsed( used, nt->pushTable );
+				shareUsed( used, nt->popAction );
+				shareConds( conds, nt->popCondSpace );
+				for ( ActionTable::Iter ati = nt->popTest; ati.lte(); ati++ )
+					conds.insert( ati->value );
+			}
+		}
+	}
+
+	std::string alph = shareParamType( this, hostLang );
+	std::set<std::string> locals;
+	shareLocals( id, this, locals );
+
+	long data, use;
+	bool fileScope = sharePlace( id, this, data, use );
+
+	long newBodies = 0, reused = 0;
+	for ( ActionList::Iter act = fsmCtx->actionList; act.lte(); act++ ) {
+		if ( used.find( act ) == used.end() || conds.find( act ) != conds.end() )
+			continue;
+
+		std::string key;
+		if ( !shareKey( this, act, alph, locals, key ) )
+			continue;
+
+		std::map<std::string, long>::iterator s = id->sharedBodies.find( key );
+		long sharedId;
+		if ( s != id->sharedBodies.end() ) {
+			/* Call it only if it is defined before it is used. */
+			sharedId = s->second;
+			if ( use >= 0 && id->sharedDefAt[sharedId] > use )
+				continue;
+			reused += 1;
+		}
+		else {
+			/* Define only bodies that repeat, where a function can go. */
+			if ( id->sharedCounts[key] < 2 || !fileScope ||
+					( use >= 0 && data > use ) )
+				continue;
+
+			std::string body = key.substr( alph.size() + 1 );
+			sharedId = id->sharedBodies.size();
+			id->sharedBodies[key] = sharedId;
+			id->sharedDefAt.push_back( data );
+
+			std::stringstream def;
+			def << "static void _rl_action_" << sharedId <<
+					"( " << alph << " *p )\n{\n\t" << body << "\n}\n";
+			sharedDefs.push_back( def.str() );
+			newBodies += 1;
+		}
+
+		std::stringstream call;
+		call << "{ _rl_action_" << sharedId << "( ";
+
+		InlineList *il = new InlineList;
+		il->append( new InlineItem( act->loc, call.str(), InlineItem::Text ) );
+		il->append( new InlineItem( act->loc, InlineItem::PChar ) );
+		il->append( new InlineItem( act->loc, " ); }", InlineItem::Text ) );
+		delete act->inlineList;
+		act->inlineList = il;
+	}
+
+	if ( id->printStatistics ) {
+		id->stats() << "fsm-shared-new\t" << newBodies << endl;
+		id->stats() << "fsm-shared-reused\t" << reused << endl;
+	}
+}
+
+/* The bodies first used by this section. Written with its first data. */
+void ParseData::writeSharedActions( std::ostream &out )
+{
+	for ( size_t d = 0; d < sharedDefs.size(); d++ )
+		out << sharedDefs[d] << "\n";
+	sharedDefs.clear();
+}
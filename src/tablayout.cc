@@ -0,0 +1,465 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tablayout.h"
+
+#include <libfsm/ragel.h>
+
+#include <map>
+#include <set>
+#include <algorithm>
+
+using std::endl;
+
+/* Widest row we are willing to expand when building the comb vector. */
+#define COMB_MAX_ROW 0x10000
+
+/* States per block in delta encoded offset tables. */
+#define PACK_BLOCK 16
+
+TableLayout::TableLayout( FsmCtx *fsmCtx, FsmAp *fsm )
+:
+	fsmCtx(fsmCtx),
+	fsm(fsm),
+	numStates(0),
+	numTrans(0),
+	numCondTrans(0),
+	coldTrans(0),
+	coldStates(0),
+	keyWidth(0),
+	stateWidth(0),
+	offsetWidth(0),
+	actionWidth(0),
+	hotStateRecord(0),
+	hotTransRecord(0),
+	hotBytes(0),
+	coldBytes(0),
+	binaryBytes(0),
+	flatBytes(0),
+	combPacked(false),
+	combEntries(0),
+	combLength(0),
+	combBytes(0),
+	packBeforeBytes(0),
+	packAfterBytes(0),
+	packedTablesCount(0),
+	deltaBeforeBytes(0),
+	deltaAfterBytes(0)
+{
+}
+
+int TableLayout::widthFor( unsigned long long max )
+{
+	if ( max <= 0xff )
+		return 1;
+	else if ( max <= 0xffff )
+		return 2;
+	else if ( max <= 0xffffffff )
+		return 4;
+	return 8;
+}
+
+int TableLayout::bitsFor( unsigned long long max )
+{
+	if ( max <= 0x1 )
+		return 1;
+	else if ( max <= 0x3 )
+		return 2;
+	else if ( max <= 0xf )
+		return 4;
+	return 0;
+}
+
+/* Size of a record holding fields of the given widths, padded so that an
+ * array of them keeps every field aligned. */
+static int recordSize( int w1, int w2, int w3 )
+{
+	int align = w1 > w2 ? w1 : w2;
+	if ( w3 > align )
+		align = w3;
+
+	int size = w1 + w2 + w3;
+	return ( size + align - 1 ) / align * align;
+}
+
+void TableLayout::analyze()
+{
+	KeyOps *keyOps = fsmCtx->keyOps;
+	long maxRanges = 0;
+	long coldStateFields = 0;
+
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		bool stateCold = false;
+
+		numStates += 1;
+		numTrans += st->outList.length();
+		if ( st->outList.length() > maxRanges )
+			maxRanges = st->outList.length();
+
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			bool transCold = false;
+			if ( trans->plain() ) {
+				if ( trans->tdap()->actionTable.length() > 0 )
+					transCold = true;
+			}
+			else {
+				/* The condition space and the per-condition targets are
+				 * always out of line. */
+				numCondTrans += 1;
+				transCold = true;
+			}
+
+			if ( transCold )
+				coldTrans += 1;
+		}
+
+		if ( st->toStateActionTable.length() > 0 ) {
+			coldStateFields += 1;
+			stateCold = true;
+		}
+		if ( st->fromStateActionTable.length() > 0 ) {
+			coldStateFields += 1;
+			stateCold = true;
+		}
+		if ( st->eofActionTable.length() > 0 || st->eofTarget != 0 ) {
+			coldStateFields += 1;
+			stateCold = true;
+		}
+		if ( st->nfaOut != 0 )
+			stateCold = true;
+
+		if ( stateCold )
+			coldStates += 1;
+	}
+
+	keyWidth = widthFor( keyOps->span( keyOps->minKey, keyOps->maxKey ) - 1 );
+	stateWidth = widthFor( numStates );
+	offsetWidth = widthFor( numTrans );
+	actionWidth = widthFor( fsmCtx->actionList.length() );
+
+	/* State record: offset of the first range, number of ranges. Transition
+	 * record: low key, high key, target state. */
+	hotStateRecord = recordSize( offsetWidth, widthFor( maxRanges ), 0 );
+	hotTransRecord = recordSize( keyWidth, keyWidth, stateWidth );
+
+	hotBytes = numStates * hotStateRecord + numTrans * hotTransRecord;
+
+	/* Binary search: two keys and an index per range plus the per-state
+	 * offsets and lengths. Flat: one index per key in each state's span. */
+	binaryBytes = numTrans * ( 2 * keyWidth + offsetWidth ) +
+			numStates * ( 2 * offsetWidth );
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		if ( st->outList.length() > 0 ) {
+			unsigned long long span = keyOps->span(
+					st->outList.head->lowKey, st->outList.tail->highKey );
+			flatBytes += span * offsetWidth;
+		}
+		flatBytes += 2 * keyWidth + offsetWidth;
+	}
+
+	/* Cold data is stored only for the states and transitions that have it,
+	 * each entry keyed by the owner's index. */
+	coldBytes = coldTrans * ( offsetWidth + actionWidth ) +
+			coldStateFields * ( stateWidth + actionWidth );
+}
+
+struct CombRow
+{
+	CombRow( StateAp *state ) : state(state) {}
+
+	StateAp *state;
+	std::vector<unsigned long long> keys;
+
+	bool operator<( const CombRow &other ) const
+		{ return keys.size() > other.keys.size(); }
+};
+
+void TableLayout::combVector()
+{
+	KeyOps *keyOps = fsmCtx->keyOps;
+	std::vector<CombRow> rows;
+
+	/* Targets are numbered so that ties between default candidates are
+	 * broken the same way on every run: zero is the error state, then the
+	 * states in list order, then conditional transitions in list order. */
+	std::map<StateAp*, long> stateIds;
+	long nextId = 1;
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ )
+		stateIds[st] = nextId++;
+
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		/* Pick the default target: the one covering the most keys. Gaps
+		 * between ranges go to the error state. Each conditional transition
+		 * is its own target. */
+		std::vector<long> targs;
+		std::map<long, unsigned long long> weights;
+		unsigned long long covered = 0;
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			unsigned long long span = keyOps->span( trans->lowKey, trans->highKey );
+			long targ = 0;
+			if ( !trans->plain() )
+				targ = nextId++;
+			else if ( trans->tdap()->toState != 0 )
+				targ = stateIds[trans->tdap()->toState];
+			targs.push_back( targ );
+			weights[targ] += span;
+			covered += span;
+		}
+		weights[0] += keyOps->span( keyOps->minKey, keyOps->maxKey ) - covered;
+
+		long defTarg = 0;
+		unsigned long long defWeight = 0;
+		for ( std::map<long, unsigned long long>::iterator w = weights.begin();
+				w != weights.end(); w++ )
+		{
+			if ( w->second > defWeight ) {
+				defTarg = w->first;
+				defWeight = w->second;
+			}
+		}
+
+		CombRow row( st );
+		long t = 0;
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++, t++ ) {
+			if ( targs[t] == defTarg )
+				continue;
+
+			unsigned long long first = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+			unsigned long long span = keyOps->span( trans->lowKey, trans->highKey );
+			if ( row.keys.size() + span > COMB_MAX_ROW )
+				return;
+
+			for ( unsigned long long k = 0; k < span; k++ )
+				row.keys.push_back( first + k );
+		}
+
+		/* Error gaps are entries too when error is not the default. */
+		if ( defTarg != 0 ) {
+			unsigned long long next = 0;
+			for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+				unsigned long long first = keyOps->span( keyOps->minKey, trans->lowKey ) - 1;
+				if ( first - next > COMB_MAX_ROW - row.keys.size() )
+					return;
+				for ( ; next < first; next++ )
+					row.keys.push_back( next );
+				next = first + keyOps->span( trans->lowKey, trans->highKey );
+			}
+
+			unsigned long long end = keyOps->span( keyOps->minKey, keyOps->maxKey );
+			if ( end - next > COMB_MAX_ROW - row.keys.size() )
+				return;
+			for ( ; next < end; next++ )
+				row.keys.push_back( next );
+		}
+
+		std::sort( row.keys.begin(), row.keys.end() );
+		rows.push_back( row );
+	}
+
+	/* First-fit, densest rows first. The search for a row starts with its
+	 * first key on the lowest free slot, since nothing below it can fit. */
+	std::stable_sort( rows.begin(), rows.end() );
+	std::vector<bool> used;
+	unsigned long long firstFree = 0;
+	for ( std::vector<CombRow>::iterator row = rows.begin(); row != rows.end(); row++ ) {
+		if ( row->keys.size() == 0 )
+			continue;
+
+		unsigned long long low = row->keys.front();
+		unsigned long long base = firstFree;
+		while ( true ) {
+			bool fits = true;
+			for ( std::vector<unsigned long long>::iterator k = row->keys.begin();
+					k != row->keys.end(); k++ )
+			{
+				unsigned long long pos = base + *k - low;
+				if ( pos < used.size() && used[pos] ) {
+					fits = false;
+					break;
+				}
+			}
+
+			if ( fits )
+				break;
+			base += 1;
+		}
+
+		for ( std::vector<unsigned long long>::iterator k = row->keys.begin();
+				k != row->keys.end(); k++ )
+		{
+			unsigned long long pos = base + *k - low;
+			if ( pos >= used.size() )
+				used.resize( pos + 1, false );
+			used[pos] = true;
+		}
+
+		while ( firstFree < used.size() && used[firstFree] )
+			firstFree += 1;
+
+		combEntries += row->keys.size();
+	}
+
+	combPacked = true;
+	combLength = used.size();
+
+	/* Per state: base and default target. Per slot: next target and the
+	 * owning state in check. */
+	combBytes = numStates * ( widthFor( combLength ) + stateWidth ) +
+			combLength * ( stateWidth + stateWidth );
+}
+
+/* Action tables are shared by value in the generated code and stored one
+ * after another, each preceded by its length, in one actions array. */
+typedef std::set< std::vector<Action*> > ActionTableSet;
+
+static void addActionTable( ActionTableSet &tables, const ActionTable &table )
+{
+	if ( table.length() == 0 )
+		return;
+
+	std::vector<Action*> key;
+	for ( ActionTable::Iter act = table; act.lte(); act++ )
+		key.push_back( act->value );
+	tables.insert( key );
+}
+
+void TableLayout::packedTables()
+{
+	/* Per-state small-range tables. */
+	enum { SingleLens, RangeLens, ToState, FromState, EofAction,
+			EofTrans, CondFlag, NumSmall };
+	std::vector<unsigned long long> maxVal( NumSmall, 0 );
+	ActionTableSet tables;
+	bool hasTo = false, hasFrom = false, hasEof = false;
+
+	/* Per-state monotonic offset tables: into the keys and into the
+	 * transitions. */
+	std::vector<unsigned long long> keyOffsets, transOffsets;
+	unsigned long long keyOffset = 0, transOffset = 0;
+
+	for ( StateList::Iter st = fsm->stateList; st.lte(); st++ ) {
+		unsigned long long vals[NumSmall] = { 0 };
+		for ( TransList::Iter trans = st->outList; trans.lte(); trans++ ) {
+			if ( fsmCtx->keyOps->eq( trans->lowKey, trans->highKey ) )
+				vals[SingleLens] += 1;
+			else
+				vals[RangeLens] += 1;
+			if ( trans->plain() )
+				addActionTable( tables, trans->tdap()->actionTable );
+			else {
+				vals[CondFlag] = 1;
+				for ( CondList::Iter cond = trans->tcap()->condList; cond.lte(); cond++ )
+					addActionTable( tables, cond->actionTable );
+			}
+		}
+
+		addActionTable( tables, st->toStateActionTable );
+		addActionTable( tables, st->fromStateActionTable );
+		addActionTable( tables, st->eofActionTable );
+		hasTo = hasTo || st->toStateActionTable.length() > 0;
+		hasFrom = hasFrom || st->fromStateActionTable.length() > 0;
+		hasEof = hasEof || st->eofActionTable.length() > 0;
+		vals[EofTrans] = st->eofTarget != 0 ? 1 : 0;
+
+		for ( int t = 0; t < NumSmall; t++ ) {
+			if ( vals[t] > maxVal[t] )
+				maxVal[t] = vals[t];
+		}
+
+		keyOffsets.push_back( keyOffset );
+		transOffsets.push_back( transOffset );
+		keyOffset += vals[SingleLens] + 2 * vals[RangeLens];
+		transOffset += st->outList.length();
+	}
+
+	/* The to-state, from-state and eof action fields hold offsets into the
+	 * actions array, not table numbers, so their range is its length. */
+	unsigned long long actionsLen = 1;
+	for ( ActionTableSet::iterator t = tables.begin(); t != tables.end(); t++ )
+		actionsLen += 1 + t->size();
+	maxVal[ToState] = hasTo ? actionsLen : 0;
+	maxVal[FromState] = hasFrom ? actionsLen : 0;
+	maxVal[EofAction] = hasEof ? actionsLen : 0;
+
+	for ( int t = 0; t < NumSmall; t++ ) {
+		/* All zero: no actions, conditions or eof targets of this kind, and
+		 * the generators do not write the table at all. */
+		if ( maxVal[t] == 0 )
+			continue;
+
+		long before = numStates * widthFor( maxVal[t] );
+		int bits = bitsFor( maxVal[t] );
+		packBeforeBytes += before;
+		if ( bits > 0 ) {
+			packAfterBytes += ( numStates * bits + 7 ) / 8;
+			packedTablesCount += 1;
+		}
+		else {
+			packAfterBytes += before;
+		}
+	}
+
+	/* Delta encoding: a full-width base at the start of each block, then the
+	 * distance from the base for every state in it. */
+	std::vector<unsigned long long> *offsets[] = { &keyOffsets, &transOffsets };
+	unsigned long long totals[] = { keyOffset, transOffset };
+	for ( int o = 0; o < 2; o++ ) {
+		std::vector<unsigned long long> &offs = *offsets[o];
+		unsigned long long maxDelta = 0;
+		for ( size_t s = 0; s < offs.size(); s++ ) {
+			unsigned long long delta = offs[s] - offs[s - s % PACK_BLOCK];
+			if ( delta > maxDelta )
+				maxDelta = delta;
+		}
+
+		long blocks = ( numStates + PACK_BLOCK - 1 ) / PACK_BLOCK;
+		long before = numStates * widthFor( totals[o] );
+		long after = blocks * widthFor( totals[o] ) + numStates * widthFor( maxDelta );
+
+		deltaBeforeBytes += before;
+		deltaAfterBytes += after < before ? after : before;
+	}
+}
+
+void TableLayout::writeStats( std::ostream &out )
+{
+	out << "fsm-trans\t" << numTrans << endl;
+	out << "fsm-cond-trans\t" << numCondTrans << endl;
+	out << "fsm-cold-states\t" << coldStates << endl;
+	out << "fsm-cold-trans\t" << coldTrans << endl;
+	out << "fsm-hot-state-record\t" << hotStateRecord << endl;
+	out << "fsm-hot-trans-record\t" << hotTransRecord << endl;
+	out << "fsm-hot-bytes\t" << hotBytes << endl;
+	out << "fsm-cold-bytes\t" << coldBytes << endl;
+	out << "fsm-binary-bytes\t" << binaryBytes << endl;
+	out << "fsm-flat-bytes\t" << flatBytes << endl;
+	if ( combPacked ) {
+		out << "fsm-comb-entries\t" << combEntries << endl;
+		out << "fsm-comb-length\t" << combLength << endl;
+		out << "fsm-comb-bytes\t" << combBytes << endl;
+	}
+	out << "fsm-packed-tables\t" << packedTablesCount << endl;
+	out << "fsm-pack-before-bytes\t" << packBeforeBytes << endl;
+	out << "fsm-pack-after-bytes\t" << packAfterBytes << endl;
+	out << "fsm-delta-before-bytes\t" << deltaBeforeBytes << endl;
+	out << "fsm-delta-after-bytes\t" << deltaAfterBytes << endl;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 Adrian Thurston <thurston@colm.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _TABLAYOUT_H
+#define _TABLAYOUT_H
+
+#include <iostream>
+#include <vector>
+#include <libfsm/fsmgraph.h>
+
+/*
+ * Analysis of the table data a machine will need, split by how often the
+ * executing machine reads it. The hot part is what every transition touches:
+ * the per-state key offset and length and the per-transition key range and
+ * target. Everything else (action lists, to/from-state and eof actions, eof
+ * targets, conditions) is cold for most states. The sizes are computed from
+ * the final graph so they can be reported with -s before committing to a
+ * table layout.
+ */
+struct TableLayout
+{
+	TableLayout( FsmCtx *fsmCtx, FsmAp *fsm );
+
+	void analyze();
+	void combVector();
+	void packedTables();
+	void writeStats( std::ostream &out );
+
+	/* Smallest unsigned element size, in bytes, that can hold max. */
+	static int widthFor( unsigned long long max );
+
+	/* Bits per element when packing values up to max: 1, 2 or 4, or zero if
+	 * it needs more than four. */
+	static int bitsFor( unsigned long long max );
+
+	FsmCtx *fsmCtx;
+	FsmAp *fsm;
+
+	long numStates;
+	long numTrans;
+	long numCondTrans;
+
+	/* Transitions and states that carry any cold data. */
+	long coldTrans;
+	long coldStates;
+
+	int keyWidth;
+	int stateWidth;
+	int offsetWidth;
+	int actionWidth;
+
+	/* Sizes of the interleaved hot records, rounded up to their alignment. */
+	int hotStateRecord;
+	int hotTransRecord;
+
+	long hotBytes;
+	long coldBytes;
+
+	/* Sizes of the equivalent binary search and flat tables. */
+	long binaryBytes;
+	long flatBytes;
+
+	/* Row-displacement (base/next/check) packing. Each state's row holds only
+	 * the keys that do not go to its default target. The rows are overlaid
+	 * first-fit into one next/check vector. Not computed when a row would be
+	 * too wide to expand (large alphabets). */
+	bool combPacked;
+	long combEntries;
+	long combLength;
+	long combBytes;
+
+	/* The per-state tables with a small range (lengths, action offsets,
+	 * eof and condition flags) stored with one byte or more per entry, and
+	 * bit-packed where the range allows. The monotonic offset tables stored
+	 * whole, and as a full offset every PACK_BLOCK states with narrow deltas
+	 * in between. */
+	long packBeforeBytes;
+	long packAfterBytes;
+	long packedTablesCount;
+	long deltaBeforeBytes;
+	long deltaAfterBytes;
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * @LANG: c
+ * @RAGEL_FLAGS: --table-blob
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+%%{
+	machine blob;
+
+	action word { printf( "word\n" ); }
+	action num { printf( "num\n" ); }
+
+	item = [a-z]+ %word | [0-9]+ %num;
+	main := item ( ',' item )*;
+}%%
+
+%% write data;
+
+int scan( const char *str )
+{
+	const char *p = str, *pe = str + strlen( str ), *eof = pe;
+	int cs;
+
+	%% write init;
+	%% write exec;
+
+	return cs >= blob_first_final;
+}
+
+int main()
+{
+	printf( "%d\n", scan( "ab,12,c" ) );
+	printf( "%d\n", scan( "ab,,c" ) );
+	return 0;
+}
+
+##### OUTPUT #####
+word
+num
+word
+1
+word
+0
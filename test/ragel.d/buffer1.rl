@@ -0,0 +1,70 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+%%{
+	machine words;
+
+	main := |*
+		[a-z]+ => { printf( "word: %.*s\n", (int)( te - ts ), ts ); };
+		[0-9]+ => { printf( "num: %.*s\n", (int)( te - ts ), ts ); };
+		' ';
+	*|;
+}%%
+
+%% write data;
+%% write buffer;
+
+int main()
+{
+	const char *input = "foo bar bazzzzzzzzzz 12";
+	struct words_buf b;
+	char *p, *pe, *eof = 0, *ts = 0, *te = 0;
+	int fds[2], cs, act;
+	long len;
+
+	if ( pipe( fds ) != 0 )
+		return 1;
+	if ( write( fds[1], input, strlen( input ) ) < 0 )
+		return 1;
+	close( fds[1] );
+
+	/* Small enough that tokens are broken and the buffer must grow. */
+	words_buf_open( &b, fds[0], 4, 0, &p, &pe );
+
+	%% write init;
+
+	while ( 1 ) {
+		len = words_buf_fill( &b, &p, &pe, &eof, &ts, &te );
+		if ( len < 0 ) {
+			printf( "error\n" );
+			break;
+		}
+
+		%% write exec;
+
+		if ( cs == words_error ) {
+			printf( "error\n" );
+			break;
+		}
+		if ( len == 0 )
+			break;
+	}
+
+	words_buf_close( &b );
+	close( fds[0] );
+	return 0;
+}
+
+##### OUTPUT #####
+word: foo
+word: bar
+word: bazzzzzzzzzz
+num: 12
@@ -0,0 +1,49 @@
+/*
+ * @LANG: c
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+%%{
+	machine capture;
+
+	main := :capture( 0, [a-z]+ ): '=' :capture( 1, [0-9]+ ):;
+}%%
+
+%% write data;
+
+void test( const char *data )
+{
+	int cs;
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const char *eof = pe;
+	const char *cap[4] = { 0, 0, 0, 0 };
+
+	%% write init;
+	%% write exec;
+
+	if ( cs >= capture_first_final ) {
+		printf( "%.*s %.*s\n", (int)( cap[1] - cap[0] ), cap[0],
+				(int)( cap[3] - cap[2] ), cap[2] );
+	}
+	else {
+		printf( "FAIL\n" );
+	}
+}
+
+int main()
+{
+	test( "abc=123" );
+	test( "x=9" );
+	test( "abc=" );
+	test( "=1" );
+	return 0;
+}
+
+##### OUTPUT #####
+abc 123
+x 9
+FAIL
+FAIL
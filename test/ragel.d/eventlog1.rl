@@ -0,0 +1,97 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+const char *buf;
+
+%%{
+	machine eventlog;
+
+	action start_word {
+		printf( "start %d %c\n", (int)(fpc - buf), fc );
+	}
+
+	action end_word {
+		printf( "end %d\n", (int)(fpc - buf) );
+	}
+
+	word = [a-z]+ >start_word %end_word;
+	main := ( word ' '+ )* word?;
+}%%
+
+%% write data;
+
+void process( struct eventlog_event *ev, int ev_len )
+{
+	%% write events;
+}
+
+/* Small buffer so the machine has to stop and let us drain it. */
+#define EV_CAP 4
+
+int exec( int cs, const char **pp, const char *pe, const char *eof )
+{
+	struct eventlog_event ev[EV_CAP];
+	int ev_len = 0;
+	int ev_cap = EV_CAP;
+	const char *p = *pp;
+
+	%% write exec events;
+
+	process( ev, ev_len );
+	*pp = p;
+	return cs;
+}
+
+void test( const char *data )
+{
+	int cs;
+	const char *p = data;
+	const char *pe = data + strlen( data );
+
+	buf = data;
+	%% write init;
+
+	while ( p < pe && cs != eventlog_error )
+		cs = exec( cs, &p, pe, 0 );
+
+	/* Eof events come from a final call once all characters are done. */
+	if ( cs != eventlog_error )
+		cs = exec( cs, &p, pe, pe );
+
+	if ( cs >= eventlog_first_final )
+		printf( "ACCEPT\n" );
+	else
+		printf( "FAIL\n" );
+}
+
+int main()
+{
+	test( "hello world" );
+	test( "a b  cd ef gh" );
+	test( "ab1" );
+	return 0;
+}
+
+##### OUTPUT #####
+start 0 h
+end 5
+start 6 w
+end 11
+ACCEPT
+start 0 a
+end 1
+start 2 b
+end 3
+start 5 c
+end 7
+start 8 e
+end 10
+start 11 g
+end 13
+ACCEPT
+start 0 a
+FAIL
@@ -317,7 +317,7 @@ function run_test()
 	classfile=$wk/`echo $lroot$gen_opt.class | sed 's/-\+/_/g'`
 	classname=`echo $lroot$gen_opt | sed 's/-\+/_/g'`
 
-	opts="$gen_opt $min_opt $enc_opt $f_opt"
+	opts="$gen_opt $min_opt $enc_opt $f_opt $case_ragel_flags"
 	args="-I. $opts -o $code_src $translated"
 
 	cat >> $sh <<-EOF
@@ -339,6 +339,8 @@ function run_test()
 	if [ $interpreted != "true" ]; then
 		cat >> $sh <<-EOF
 		$compiler $flags $out_args $code_src \
+				\`ls ${code_src%.*}-tab*.$code_suffix 2>/dev/null\` \
+				\`test -f ${code_src%.*}.rlt && echo -Wa,-I$wk\` \
 				$libs >>$log 2>>$log
 		EOF
 	fi
@@ -432,6 +434,9 @@ function run_translate()
 	# Add these into the langugage-specific defaults selected in run_options
 	case_prohibit_flags=`sed '/@PROHIBIT_FLAGS:/s/^.*: *//p;d' $test_case`
 
+	# Extra options passed to ragel for every run of the case.
+	case_ragel_flags=`sed '/@RAGEL_FLAGS:/s/^.*: *//p;d' $test_case`
+
 	lang=`sed '/@LANG:/s/^.*: *//p;d' $test_case`
 	if [ -z "$lang" ]; then
 		echo "$test_case: language unset"; >&2
@@ -0,0 +1,78 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+%%{
+	machine iovec;
+
+	action start_word {
+		word_seg = iov_seg;
+		word_p = fpc;
+	}
+
+	action end_word {
+		iovec_iov_span( iov, word_seg, word_p, iov_seg, fpc, piece, 0 );
+		printf( "\n" );
+	}
+
+	word = [a-z]+ >start_word %end_word;
+	main := ( word ' '+ )* word?;
+}%%
+
+%% write data;
+
+void piece( const char *p, const char *pe, void *ctx )
+{
+	printf( "[%.*s]", (int)(pe - p), p );
+}
+
+void test( const char **segs, int n )
+{
+	struct iovec iov[8];
+	int iovcnt = n;
+	int iov_seg = 0;
+	const char *p = 0, *pe = 0, *eof;
+	int word_seg = 0;
+	const char *word_p = 0;
+	int cs, i;
+
+	for ( i = 0; i < n; i++ ) {
+		iov[i].iov_base = (void*)segs[i];
+		iov[i].iov_len = strlen( segs[i] );
+	}
+	eof = segs[n-1] + strlen( segs[n-1] );
+
+	%% write init;
+	%% write exec iovec;
+
+	if ( cs >= iovec_first_final )
+		printf( "ACCEPT\n" );
+	else
+		printf( "FAIL %d\n", iov_seg );
+}
+
+const char *t1[] = { "hel", "lo wo", "rld" };
+const char *t2[] = { "ab", "", " c" };
+const char *t3[] = { "ab ", "c1" };
+
+int main()
+{
+	test( t1, 3 );
+	test( t2, 3 );
+	test( t3, 2 );
+	return 0;
+}
+
+##### OUTPUT #####
+[hel][lo]
+[wo][rld]
+ACCEPT
+[ab]
+[c]
+ACCEPT
+[ab]
+FAIL 1
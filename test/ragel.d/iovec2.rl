@@ -0,0 +1,73 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+%%{
+	machine iovscan;
+
+	main := |*
+		[a-z]+ => { printf( "word(%.*s)\n", (int)(te - ts), ts ); };
+		[0-9]+ ( '.' [0-9]+ )? => { printf( "num(%.*s)\n", (int)(te - ts), ts ); };
+		'.' => { printf( "punct(.)\n" ); };
+		' '+;
+	*|;
+}%%
+
+%% write data;
+
+void test( const char **segs, int n, long buflen )
+{
+	struct iovec iov[8];
+	int iovcnt = n;
+	int iov_seg = 0;
+	char buf[16];
+	char *iov_buf = buf;
+	long iov_buflen = buflen;
+	const char *p = 0, *pe = 0, *eof;
+	const char *ts, *te;
+	int cs, act, i;
+
+	for ( i = 0; i < n; i++ ) {
+		iov[i].iov_base = (void*)segs[i];
+		iov[i].iov_len = strlen( segs[i] );
+	}
+	eof = segs[n-1] + strlen( segs[n-1] );
+
+	%% write init;
+	%% write exec iovec;
+
+	if ( iov_seg == iovcnt )
+		printf( "END\n" );
+	else if ( p == 0 )
+		printf( "TOO LONG %d\n", iov_seg );
+	else
+		printf( "STOP %d\n", iov_seg );
+}
+
+const char *t1[] = { "ab", "c 12", ".", "5 3", ".x" };
+const char *t2[] = { "ab ", "cd" };
+const char *t3[] = { "abcdef", "ghijklmn" };
+
+int main()
+{
+	test( t1, 5, 16 );
+	test( t2, 2, 16 );
+	test( t3, 2, 8 );
+	return 0;
+}
+
+##### OUTPUT #####
+word(abc)
+num(12.5)
+num(3)
+punct(.)
+word(x)
+END
+word(ab)
+word(cd)
+END
+TOO LONG 1
@@ -0,0 +1,56 @@
+/*
+ * @LANG: c
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+%%{
+	machine classify;
+
+	main :=
+		:match( 1, 'abc' ): |
+		:match( 2, 'ab' [a-z]* ): |
+		:match( 3, [0-9]+ ): |
+		:match( 4, 'abc' | '12' ):;
+}%%
+
+%% write data;
+
+void test( const char *data )
+{
+	int cs, n, i;
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const int *ids;
+
+	%% write init;
+	%% write exec;
+
+	n = classify_matches( cs, &ids );
+	printf( "%s:", data );
+	for ( i = 0; i < n; i++ )
+		printf( " %d", ids[i] );
+	printf( "\n" );
+}
+
+int main()
+{
+	test( "abc" );
+	test( "abd" );
+	test( "ab" );
+	test( "12" );
+	test( "123" );
+	test( "a" );
+	test( "x" );
+	return 0;
+}
+
+##### OUTPUT #####
+abc: 1 2 4
+abd: 2
+ab: 2
+12: 3 4
+123: 3
+a:
+x:
@@ -0,0 +1,54 @@
+/*
+ * @LANG: c
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+%%{
+	machine bits;
+
+	main |= ( 1, 0 )
+		( 'a' | 'b' )* 'abb' |
+		'c'+ 'd' |
+		( any* 'x' ){3} any*;
+}%%
+
+%% write exec_bitset;
+
+void test( const char *data )
+{
+	struct bits_bitset b;
+	int alive;
+
+	bits_bitset_init( &b );
+	alive = bits_bitset_exec( &b, data, data + strlen( data ) );
+
+	if ( alive && bits_bitset_accept( &b ) )
+		printf( "ACCEPT\n" );
+	else
+		printf( "FAIL\n" );
+}
+
+int main()
+{
+	test( "abb" );
+	test( "aabababb" );
+	test( "babab" );
+	test( "cccd" );
+	test( "cdd" );
+	test( "d" );
+	test( "xaxbbx" );
+	test( "xxyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyy" );
+	return 0;
+}
+
+##### OUTPUT #####
+ACCEPT
+ACCEPT
+FAIL
+ACCEPT
+FAIL
+FAIL
+ACCEPT
+FAIL
@@ -0,0 +1,75 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+%%{
+	machine par;
+
+	# Lines of comma-separated numbers.
+	line = [0-9]+ ( ',' [0-9]+ )* '\n';
+	main := line*;
+}%%
+
+%% write data;
+%% write exec_parallel;
+
+#define NJOBS 4
+
+char buf[1024];
+
+/* Stand-in for a thread pool: runs the work items in order. */
+void pool( void (*work)( void *ctx, int i ), void *ctx, int n )
+{
+	int i;
+	for ( i = 0; i < n; i++ )
+		work( ctx, i );
+}
+
+int run( const char *data )
+{
+	int cs;
+	const char *p = data;
+	const char *pe = data + strlen( data );
+
+	%% write init;
+	%% write exec;
+
+	return cs;
+}
+
+void test( const char *data )
+{
+	struct par_job jobs[NJOBS];
+	int cs, seq;
+
+	%% write init;
+	cs = par_exec_parallel( cs, data, data + strlen( data ), jobs, NJOBS, pool );
+	seq = run( data );
+
+	printf( "%s %s\n", cs >= par_first_final ? "ACCEPT" : "FAIL",
+			cs == seq ? "same" : "different" );
+}
+
+int main()
+{
+	int i;
+
+	buf[0] = 0;
+	for ( i = 0; i < 40; i++ )
+		strcat( buf, i % 3 == 0 ? "1,22,333\n" : "4444\n" );
+
+	test( buf );
+	test( "12,34\n56\n" );
+	test( "12,,34\n56\n78\n90\n" );
+	test( "1\n2\n3\n4\n5\n6\n7\n8\n9\n0\n1\n2\n3" );
+	return 0;
+}
+
+##### OUTPUT #####
+ACCEPT same
+ACCEPT same
+FAIL same
+FAIL same
@@ -0,0 +1,60 @@
+/*
+ * @LANG: c
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+const char *buf;
+
+%%{
+	machine search;
+
+	action found {
+		printf( "found %d\n", (int)(fpc - buf) );
+	}
+
+	main := ( any* 'needle' @found )*;
+}%%
+
+%% write data;
+
+int exec( int cs, const char *p, const char *pe )
+{
+	%% write exec prefilter;
+	return cs;
+}
+
+void test( const char *data, int split )
+{
+	int cs;
+	int len = strlen( data );
+
+	buf = data;
+	%% write init;
+
+	/* Two blocks, to check a literal broken by the block boundary. */
+	cs = exec( cs, data, data + split );
+	cs = exec( cs, data + split, data + len );
+	printf( "%s\n", cs >= search_first_final ? "ACCEPT" : "FAIL" );
+}
+
+int main()
+{
+	test( "xxneedlexxneneedle", 0 );
+	test( "needleneedle", 9 );
+	test( "xxxneedlexx", 6 );
+	test( "nneedl", 3 );
+	return 0;
+}
+
+##### OUTPUT #####
+found 7
+found 17
+ACCEPT
+found 5
+found 11
+ACCEPT
+found 8
+FAIL
+FAIL
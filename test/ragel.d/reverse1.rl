@@ -0,0 +1,47 @@
+/*
+ * @LANG: c
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+%%{
+	machine rev;
+
+	main := :reverse( ( 'ab' )+ 'c' | 'x' [0-9]+ 'y' ):;
+}%%
+
+%% write exec_reverse;
+
+void test( const char *data, int lower )
+{
+	const char *start = rev_reverse( data + lower, data + strlen( data ) );
+
+	if ( start != 0 )
+		printf( "%s: %d\n", data, (int)( start - data ) );
+	else
+		printf( "%s: NONE\n", data );
+}
+
+int main()
+{
+	test( "zzababc", 0 );
+	test( "abc", 0 );
+	test( "zzbc", 0 );
+	test( "c", 0 );
+	test( "x12y", 0 );
+	test( "qx1y", 0 );
+	test( "xy", 0 );
+	test( "ababc", 2 );
+	return 0;
+}
+
+##### OUTPUT #####
+zzababc: 2
+abc: 0
+zzbc: NONE
+c: NONE
+x12y: 0
+qx1y: 1
+xy: NONE
+ababc: 2
@@ -0,0 +1,57 @@
+/*
+ * @LANG: c
+ * @RAGEL_FLAGS: --pure-scanners
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * A scanner that never backtracks, built with --pure-scanners. The token
+ * actions read ts, so the token start must still be kept.
+ */
+
+%%{
+	machine pure;
+
+	main := |*
+		[a-z]+ ';' => { printf( "word(%.*s)\n", (int)(te - ts), ts ); };
+		'(' => { printf( "open(%.*s)\n", (int)(te - ts), ts ); };
+		' ';
+	*|;
+}%%
+
+%% write data;
+
+void test( const char *data )
+{
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const char *eof = pe;
+	const char *ts, *te;
+	int cs, act;
+
+	%% write init;
+	%% write exec;
+
+	if ( cs == pure_error )
+		printf( "FAIL\n" );
+	else
+		printf( "ACCEPT\n" );
+}
+
+int main()
+{
+	test( "ab; (cd;" );
+	test( "x;(" );
+	return 0;
+}
+
+##### OUTPUT #####
+word(ab;)
+open(()
+word(cd;)
+ACCEPT
+word(x;)
+open(()
+ACCEPT
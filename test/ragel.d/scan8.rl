@@ -0,0 +1,97 @@
+/*
+ * @LANG: c
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * Worst case for longest-match backtracking. On a run of 'a' characters with
+ * no 'b' the first scanner reads to the end of the run for every token, taking
+ * quadratic time. It is rejected by --backtrack-check. The second is the same
+ * scanner with the patterns combined by hand, which reads each character once.
+ */
+
+int tok_a, tok_ab, steps;
+
+%%{
+	machine quadratic;
+
+	action step { steps += 1; }
+
+	main := |*
+		'a' $step => { tok_a += 1; };
+		( 'a'+ 'b' ) $step => { tok_ab += 1; };
+	*|;
+}%%
+
+%% write data;
+
+void quadratic( const char *data )
+{
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const char *eof = pe;
+	const char *ts, *te;
+	int cs, act;
+
+	%% write init;
+	%% write exec;
+
+	printf( "quadratic: %d %d %d\n", tok_a, tok_ab, steps );
+}
+
+%%{
+	machine linear;
+
+	action step { steps += 1; }
+
+	main := |*
+		( 'a'+ 'b'? ) $step => {
+			if ( te[-1] == 'b' )
+				tok_ab += 1;
+			else
+				tok_a += te - ts;
+		};
+	*|;
+}%%
+
+%% write data;
+
+void linear( const char *data )
+{
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const char *eof = pe;
+	const char *ts, *te;
+	int cs, act;
+
+	%% write init;
+	%% write exec;
+
+	printf( "linear:    %d %d %d\n", tok_a, tok_ab, steps );
+}
+
+void test( const char *data )
+{
+	tok_a = tok_ab = steps = 0;
+	quadratic( data );
+	tok_a = tok_ab = steps = 0;
+	linear( data );
+}
+
+int main()
+{
+	test( "aaaaaaaa" );
+	test( "aab" );
+	test( "aaba" );
+	return 0;
+}
+
+##### OUTPUT #####
+quadratic: 8 0 36
+linear:    8 0 8
+quadratic: 0 1 3
+linear:    0 1 3
+quadratic: 1 1 4
+linear:    1 1 4
@@ -0,0 +1,51 @@
+/*
+ * @LANG: c
+ * @RAGEL_FLAGS: --backtrack-check
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+/*
+ * A scanner that backtracks, but never more than one character past a match,
+ * is accepted by --backtrack-check. After 'a' it reads on for 'abc' and backs
+ * up when the 'c' does not follow.
+ */
+
+%%{
+	machine bounded;
+
+	main := |*
+		'a' => { printf( "A " ); };
+		'abc' => { printf( "ABC " ); };
+		'b' => { printf( "B " ); };
+		'c' => { printf( "C " ); };
+	*|;
+}%%
+
+%% write data;
+
+void test( const char *data )
+{
+	const char *p = data;
+	const char *pe = data + strlen( data );
+	const char *eof = pe;
+	const char *ts, *te;
+	int cs, act;
+
+	%% write init;
+	%% write exec;
+
+	printf( "%s\n", cs == bounded_error ? "FAIL" : "OK" );
+}
+
+int main()
+{
+	test( "ababcabcc" );
+	test( "aab" );
+	return 0;
+}
+
+##### OUTPUT #####
+A B ABC ABC C OK
+A A B OK
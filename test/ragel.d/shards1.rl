@@ -0,0 +1,68 @@
+/*
+ * @LANG: c
+ * @RAGEL_FLAGS: --table-shards=2
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+%%{
+	machine words;
+
+	main := ( [a-z]+ %{ printf( "word\n" ); } | [0-9]+ %{ printf( "num\n" ); } )
+			( ' ' ( [a-z]+ %{ printf( "word\n" ); } | [0-9]+ %{ printf( "num\n" ); } ) )*;
+}%%
+
+%% write data;
+
+%%{
+	machine hex;
+
+	main := '0x' [0-9a-f]+ %{ printf( "hex\n" ); };
+}%%
+
+%% write data;
+
+int scan_words( const char *str )
+{
+	const char *p = str, *pe = str + strlen( str ), *eof = pe;
+	int cs;
+
+	%% machine words;
+	%% write init;
+	%% write exec;
+
+	return cs >= words_first_final;
+}
+
+int scan_hex( const char *str )
+{
+	const char *p = str, *pe = str + strlen( str ), *eof = pe;
+	int cs;
+
+	%% machine hex;
+	%% write init;
+	%% write exec;
+
+	return cs >= hex_first_final;
+}
+
+int main()
+{
+	printf( "%d\n", scan_words( "abc 12 de" ) );
+	printf( "%d\n", scan_words( "abc -" ) );
+	printf( "%d\n", scan_hex( "0x1f" ) );
+	printf( "%d\n", scan_hex( "0y" ) );
+	return 0;
+}
+
+##### OUTPUT #####
+word
+num
+word
+1
+word
+0
+hex
+1
+0
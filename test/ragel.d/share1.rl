@@ -0,0 +1,75 @@
+/*
+ * @LANG: c
+ * @RAGEL_FLAGS: --share-actions
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+%%{
+	machine first;
+
+	action word { printf( "word\n" ); }
+	action echo { putchar( fc ); }
+
+	main := ( [a-z]+ %word | ',' @echo )*;
+}%%
+
+%% write data;
+
+%%{
+	machine second;
+
+	action word { printf( "word\n" ); }
+	action echo { putchar( fc ); }
+	action stop { if ( fc == '.' ) printf( "\n" ); }
+
+	main := ( [a-z]+ %word | [;.] @echo @stop )*;
+}%%
+
+%% write data;
+
+int run_first( const char *str )
+{
+	const char *p = str, *pe = str + strlen( str ), *eof = pe;
+	int cs;
+
+	%% machine first;
+	%% write init;
+	%% write exec;
+
+	return cs >= first_first_final;
+}
+
+int run_second( const char *str )
+{
+	const char *p = str, *pe = str + strlen( str ), *eof = pe;
+	int cs;
+
+	%% machine second;
+	%% write init;
+	%% write exec;
+
+	return cs >= second_first_final;
+}
+
+int main()
+{
+	/* Does not compile unless word and echo were shared. */
+	void (*shared[])( const char * ) = { _rl_action_0, _rl_action_1 };
+
+	printf( "%d\n", run_first( "ab,cd" ) );
+	printf( "%d\n", run_second( "ab;cd." ) );
+	printf( "%d\n", shared[0] != shared[1] );
+	return 0;
+}
+
+##### OUTPUT #####
+word
+,word
+1
+word
+;word
+.
+1
+1